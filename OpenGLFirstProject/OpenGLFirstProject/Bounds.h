@@ -0,0 +1,166 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define BOUNDS_USE_SSE
+#endif
+
+// Axis-aligned box. A default-constructed box is empty (Min > Max), so it can be grown from
+// nothing with Expand().
+struct BoundingBox
+{
+    glm::vec3 Min = glm::vec3(INFINITY);
+    glm::vec3 Max = glm::vec3(-INFINITY);
+
+    BoundingBox() {}
+    BoundingBox(const glm::vec3& min, const glm::vec3& max) : Min(min), Max(max) {}
+
+    bool Empty() const
+    {
+        return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z;
+    }
+
+    glm::vec3 Center() const
+    {
+        return (Min + Max) * 0.5f;
+    }
+
+    glm::vec3 Extents() const
+    {
+        return (Max - Min) * 0.5f;
+    }
+
+    void Expand(const glm::vec3& point)
+    {
+        Min = glm::min(Min, point);
+        Max = glm::max(Max, point);
+    }
+
+    void Expand(const BoundingBox& other)
+    {
+        if (other.Empty())
+            return;
+        Min = glm::min(Min, other.Min);
+        Max = glm::max(Max, other.Max);
+    }
+
+    // The box around this box after a transform (Arvo's method: no corners needed)
+    BoundingBox Transformed(const glm::mat4& matrix) const
+    {
+        if (Empty())
+            return *this;
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 newExtents(0.0f);
+        for (int column = 0; column < 3; column++)
+            for (int row = 0; row < 3; row++)
+                newExtents[row] += std::fabs(matrix[column][row]) * extents[column];
+        return BoundingBox(center - newExtents, center + newExtents);
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 Center = glm::vec3(0.0f);
+    float Radius = -1.0f; // Negative when empty
+
+    BoundingSphere() {}
+    BoundingSphere(const glm::vec3& center, float radius) : Center(center), Radius(radius) {}
+
+    bool Empty() const
+    {
+        return Radius < 0.0f;
+    }
+
+    // The sphere after a transform; non-uniform scales take the largest axis
+    BoundingSphere Transformed(const glm::mat4& matrix) const
+    {
+        float scale = std::max(glm::length(glm::vec3(matrix[0])),
+            std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+        return BoundingSphere(glm::vec3(matrix * glm::vec4(Center, 1.0f)), Radius * scale);
+    }
+};
+
+// Box around count points. Loading big meshes spends a fair share of its time here, so on x86
+// the points are reduced four at a time: three unaligned loads cover four packed vec3s
+// (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3), each lane always lands on the same component,
+// and the lanes are folded back together at the end.
+inline BoundingBox computeBoundingBox(const glm::vec3* points, size_t count)
+{
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "vec3 must be tightly packed");
+
+    BoundingBox box;
+    size_t i = 0;
+#ifdef BOUNDS_USE_SSE
+    if (count >= 4)
+    {
+        const float* data = &points[0].x;
+        __m128 min0 = _mm_loadu_ps(data), min1 = _mm_loadu_ps(data + 4), min2 = _mm_loadu_ps(data + 8);
+        __m128 max0 = min0, max1 = min1, max2 = min2;
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            const float* p = data + i * 3;
+            __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+            min0 = _mm_min_ps(min0, a); max0 = _mm_max_ps(max0, a);
+            min1 = _mm_min_ps(min1, b); max1 = _mm_max_ps(max1, b);
+            min2 = _mm_min_ps(min2, c); max2 = _mm_max_ps(max2, c);
+        }
+
+        float lo[12], hi[12];
+        _mm_storeu_ps(lo, min0); _mm_storeu_ps(lo + 4, min1); _mm_storeu_ps(lo + 8, min2);
+        _mm_storeu_ps(hi, max0); _mm_storeu_ps(hi + 4, max1); _mm_storeu_ps(hi + 8, max2);
+        // Lane k of the twelve holds component k % 3
+        for (int lane = 0; lane < 12; lane++)
+        {
+            box.Min[lane % 3] = std::min(box.Min[lane % 3], lo[lane]);
+            box.Max[lane % 3] = std::max(box.Max[lane % 3], hi[lane]);
+        }
+    }
+#endif
+    for (; i < count; i++)
+        box.Expand(points[i]);
+    return box;
+}
+
+inline BoundingBox computeBoundingBox(const std::vector<glm::vec3>& points)
+{
+    return computeBoundingBox(points.data(), points.size());
+}
+
+// Sphere around the box centre, just big enough for every point. Not the tightest sphere,
+// but one pass and stable, which is what culling and LOD selection want.
+inline BoundingSphere computeBoundingSphere(const std::vector<glm::vec3>& points, const BoundingBox& box)
+{
+    if (box.Empty())
+        return BoundingSphere();
+    glm::vec3 center = box.Center();
+    float radiusSquared = 0.0f;
+    for (const glm::vec3& p : points)
+    {
+        glm::vec3 d = p - center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+    return BoundingSphere(center, std::sqrt(radiusSquared));
+}
+
+// Smallest sphere around the box centre that holds every sphere
+inline BoundingSphere enclosingSphere(const BoundingBox& box, const std::vector<BoundingSphere>& spheres)
+{
+    if (box.Empty())
+        return BoundingSphere();
+    BoundingSphere result(box.Center(), 0.0f);
+    for (const BoundingSphere& sphere : spheres)
+        if (!sphere.Empty())
+            result.Radius = std::max(result.Radius, glm::length(sphere.Center - result.Center) + sphere.Radius);
+    return result;
+}
+
+#endif
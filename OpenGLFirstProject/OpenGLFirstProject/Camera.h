@@ -60,12 +60,12 @@ public:
         updateCameraVectors();
     }
 
-    glm::mat4 GetViewMatrix()
+    glm::mat4 GetViewMatrix() const
     {
         return customLookAt(Position, Position + Front, Up);
     }
 
-    glm::mat4 GetViewMatrix_Behind()
+    glm::mat4 GetViewMatrix_Behind() const
     {
         return customLookAt(Position, Position - Front, Up);
     }
@@ -129,7 +129,7 @@ private:
         Up = glm::normalize(glm::cross(Right, Front));
     }
 
-    glm::mat4 customLookAt(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp)
+    glm::mat4 customLookAt(glm::vec3 position, glm::vec3 target, glm::vec3 worldUp) const
     {
         // Exercise 2 is to creatre our own lookat matrix
         glm::vec3 zAxis = glm::normalize(position - target);
@@ -0,0 +1,91 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "StreamingBuffer.h"
+
+#include <cstddef>
+
+// Uniform block binding points shared by every program that declares the blocks
+const unsigned int FRAME_DATA_BINDING = 0;
+const char* const FRAME_DATA_BLOCK = "FrameData";
+const unsigned int OBJECT_DATA_BINDING = 1;
+const char* const OBJECT_DATA_BLOCK = "ObjectData";
+const unsigned int LIGHT_DATA_BINDING = 2;
+const char* const LIGHT_DATA_BLOCK = "LightData";
+
+// CPU mirror of the per-frame std140 block declared in the shaders:
+//
+// layout (std140) uniform FrameData
+// {
+//     mat4 projection;
+//     mat4 view;
+//     vec3 camPos;
+// };
+struct FrameData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 camPos;
+    float padding; // std140 rounds the vec3 up to 16 bytes
+};
+
+// If any of these fire, the struct no longer matches the block in the shaders
+static_assert(sizeof(glm::mat4) == 64, "FrameData: glm::mat4 must be 16 tightly packed floats");
+static_assert(offsetof(FrameData, projection) == 0, "FrameData: projection must be at std140 offset 0");
+static_assert(offsetof(FrameData, view) == 64, "FrameData: view must be at std140 offset 64");
+static_assert(offsetof(FrameData, camPos) == 128, "FrameData: camPos must be at std140 offset 128");
+static_assert(sizeof(FrameData) == 144, "FrameData: block size must be 144 bytes");
+
+// CPU mirror of the per-draw std140 block (objectData.glsl):
+//
+// layout (std140) uniform ObjectData
+// {
+//     mat4 model;
+//     mat3 normalMatrix;
+// };
+struct ObjectData
+{
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3]; // std140 stores each mat3 column as a vec4
+
+    static ObjectData For(const glm::mat4& model)
+    {
+        ObjectData data;
+        data.model = model;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        for (int i = 0; i < 3; i++)
+            data.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+        return data;
+    }
+};
+
+static_assert(offsetof(ObjectData, normalMatrix) == 64, "ObjectData: normalMatrix must be at std140 offset 64");
+static_assert(sizeof(ObjectData) == 112, "ObjectData: block size must be 112 bytes");
+
+// Refills the FrameData block every frame. Each frame's copy goes to a fresh range of a
+// StreamingBuffer, so the update never waits for the GPU to finish reading the last one.
+class FrameUniformBuffer
+{
+public:
+    // stream must be a GL_UNIFORM_BUFFER stream that outlives this object
+    explicit FrameUniformBuffer(StreamingBuffer& stream) : stream(stream) {}
+
+    void Update(const Camera& camera, const glm::mat4& projection)
+    {
+        FrameData data;
+        data.projection = projection;
+        data.view = camera.GetViewMatrix();
+        data.camPos = camera.Position;
+        data.padding = 0.0f;
+        stream.WriteAndBind(FRAME_DATA_BINDING, data);
+    }
+
+private:
+    StreamingBuffer& stream;
+};
+
+#endif
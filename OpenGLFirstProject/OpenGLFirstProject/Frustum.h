@@ -0,0 +1,62 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// The six planes of a view frustum, facing inwards (Gribb & Hartmann). Built from a
+// projection * view matrix the planes are in world space; include a model matrix to get
+// them in that model's space instead.
+struct Frustum
+{
+    glm::vec4 Planes[6]; // Left, right, bottom, top, near, far: xyz normal, w distance
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        // glm is column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        for (int i = 0; i < 3; i++)
+        {
+            Planes[i * 2] = rows[3] + rows[i];
+            Planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4& plane : Planes)
+            plane = plane / glm::length(glm::vec3(plane));
+    }
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : Planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+    bool IntersectsSphere(const BoundingSphere& sphere) const
+    {
+        return !sphere.Empty() && IntersectsSphere(sphere.Center, sphere.Radius);
+    }
+
+    // Conservative: a box near a frustum corner can pass without being inside
+    bool IntersectsBox(const BoundingBox& box) const
+    {
+        if (box.Empty())
+            return false;
+        glm::vec3 center = box.Center(), extents = box.Extents();
+        for (const glm::vec4& plane : Planes)
+        {
+            float reach = extents.x * std::fabs(plane.x) + extents.y * std::fabs(plane.y) + extents.z * std::fabs(plane.z);
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -reach)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Runtime capability checks. The extension list is read once, the first time it's asked for,
+// so only call these with a current context.
+inline bool hasGLExtension(const char* name)
+{
+    static std::vector<std::string> extensions;
+    static bool queried = false;
+    if (!queried)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.push_back((const char*)glGetStringi(GL_EXTENSIONS, i));
+        queried = true;
+    }
+    return std::find(extensions.begin(), extensions.end(), name) != extensions.end();
+}
+
+inline bool glVersionAtLeast(int major, int minor)
+{
+    static GLint contextMajor = -1, contextMinor = -1;
+    if (contextMajor < 0)
+    {
+        glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+        glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+    }
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+#endif
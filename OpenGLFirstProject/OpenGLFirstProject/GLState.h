@@ -0,0 +1,330 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <map>
+
+// State-changing calls issued to the driver vs dropped because they changed nothing,
+// accumulated until reset (once per frame)
+struct GLStateStats
+{
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
+
+// Thin cache in front of the GL binding and fixed-function state calls. Each setter compares
+// against what it last sent and skips the call when nothing would change.
+//
+// The cache only knows about changes made through it, so all binds and enables have to go
+// through here (setup code included). Objects deleted while bound must be forgotten, because
+// GL may hand the same name out again. After running code that touches GL state directly,
+// call Invalidate() and the next call of each kind is issued unconditionally.
+class GLState
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    static void UseProgram(GLuint program)
+    {
+        State& s = state();
+        if (!change(s.program, program))
+            return;
+        glUseProgram(program);
+    }
+
+    static void BindProgramPipeline(GLuint pipeline)
+    {
+        State& s = state();
+        if (!change(s.pipeline, pipeline))
+            return;
+        glBindProgramPipeline(pipeline);
+    }
+
+    static void BindVertexArray(GLuint vao)
+    {
+        State& s = state();
+        if (!change(s.vertexArray, vao))
+            return;
+        glBindVertexArray(vao);
+    }
+
+    static void ActiveTexture(unsigned int unit)
+    {
+        State& s = state();
+        if (!change(s.activeUnit, unit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // Bind a texture to a given unit, switching the active unit only if the bind is needed
+    static void BindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        State& s = state();
+        int t = targetIndex(target);
+        if (unit < MAX_TEXTURE_UNITS && t >= 0 && s.textures[unit][t] == texture)
+        {
+            stats().elided++;
+            return;
+        }
+        ActiveTexture(unit);
+        glBindTexture(target, texture);
+        stats().issued++;
+        if (unit < MAX_TEXTURE_UNITS && t >= 0)
+            s.textures[unit][t] = texture;
+    }
+
+    // Bind to whichever unit is active, as texture setup code does
+    static void BindTexture(GLenum target, GLuint texture)
+    {
+        State& s = state();
+        if (s.activeUnit == UNKNOWN)
+            ActiveTexture(0);
+        BindTexture(s.activeUnit, target, texture);
+    }
+
+    static void BindSampler(unsigned int unit, GLuint sampler)
+    {
+        State& s = state();
+        if (unit >= MAX_TEXTURE_UNITS)
+        {
+            glBindSampler(unit, sampler);
+            stats().issued++;
+            return;
+        }
+        if (!change(s.samplers[unit], sampler))
+            return;
+        glBindSampler(unit, sampler);
+    }
+
+    // GL_FRAMEBUFFER sets both the draw and read bindings
+    static void BindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        State& s = state();
+        bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+        bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+        if ((!draw || s.drawFramebuffer == framebuffer) && (!read || s.readFramebuffer == framebuffer))
+        {
+            stats().elided++;
+            return;
+        }
+        glBindFramebuffer(target, framebuffer);
+        stats().issued++;
+        if (draw)
+            s.drawFramebuffer = framebuffer;
+        if (read)
+            s.readFramebuffer = framebuffer;
+    }
+
+    static void Enable(GLenum capability)
+    {
+        setCapability(capability, true);
+    }
+
+    static void Disable(GLenum capability)
+    {
+        setCapability(capability, false);
+    }
+
+    static void BlendFunc(GLenum source, GLenum destination)
+    {
+        State& s = state();
+        if (s.blendSource == source && s.blendDestination == destination)
+        {
+            stats().elided++;
+            return;
+        }
+        glBlendFunc(source, destination);
+        stats().issued++;
+        s.blendSource = source;
+        s.blendDestination = destination;
+    }
+
+    static void DepthFunc(GLenum func)
+    {
+        State& s = state();
+        if (!change(s.depthFunc, func))
+            return;
+        glDepthFunc(func);
+    }
+
+    static void DepthMask(bool write)
+    {
+        State& s = state();
+        if (!change(s.depthMask, write ? 1u : 0u))
+            return;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    static void CullFace(GLenum face)
+    {
+        State& s = state();
+        if (!change(s.cullFace, face))
+            return;
+        glCullFace(face);
+    }
+
+    static void Viewport(int x, int y, int width, int height)
+    {
+        State& s = state();
+        if (s.viewportKnown && s.viewport[0] == x && s.viewport[1] == y && s.viewport[2] == width && s.viewport[3] == height)
+        {
+            stats().elided++;
+            return;
+        }
+        glViewport(x, y, width, height);
+        stats().issued++;
+        s.viewport[0] = x;
+        s.viewport[1] = y;
+        s.viewport[2] = width;
+        s.viewport[3] = height;
+        s.viewportKnown = true;
+    }
+
+    // Call before deleting an object. GL unbinds deleted VAOs, textures and framebuffers from
+    // the context itself; a deleted program stays current until replaced, but its name can
+    // be reused, so it's dropped from the cache either way.
+    static void ForgetProgram(GLuint program)
+    {
+        State& s = state();
+        if (s.program == program)
+            s.program = UNKNOWN;
+    }
+
+    static void ForgetVertexArray(GLuint vao)
+    {
+        State& s = state();
+        if (s.vertexArray == vao)
+            s.vertexArray = 0;
+    }
+
+    static void ForgetTexture(GLuint texture)
+    {
+        State& s = state();
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for (int t = 0; t < TARGET_COUNT; t++)
+                if (s.textures[unit][t] == texture)
+                    s.textures[unit][t] = 0;
+    }
+
+    static void ForgetFramebuffer(GLuint framebuffer)
+    {
+        State& s = state();
+        if (s.drawFramebuffer == framebuffer)
+            s.drawFramebuffer = 0;
+        if (s.readFramebuffer == framebuffer)
+            s.readFramebuffer = 0;
+    }
+
+    // Mark everything unknown, e.g. after a library changed state behind the cache's back
+    static void Invalidate()
+    {
+        State& s = state();
+        s = State();
+        s.program = s.pipeline = s.vertexArray = s.activeUnit = UNKNOWN;
+        s.drawFramebuffer = s.readFramebuffer = UNKNOWN;
+        s.depthFunc = s.depthMask = s.cullFace = UNKNOWN;
+        s.blendSource = s.blendDestination = UNKNOWN;
+        for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+        {
+            s.samplers[unit] = UNKNOWN;
+            for (int t = 0; t < TARGET_COUNT; t++)
+                s.textures[unit][t] = UNKNOWN;
+        }
+        s.capabilities.clear();
+        s.viewportKnown = false;
+    }
+
+    static GLStateStats& FrameStats()
+    {
+        return stats();
+    }
+
+    static void ResetFrameStats()
+    {
+        stats() = GLStateStats();
+    }
+
+private:
+    static const GLuint UNKNOWN = ~0u;
+    static const int TARGET_COUNT = 5;
+
+    // Starts out matching the defaults of a freshly created context
+    struct State
+    {
+        GLuint program = 0;
+        GLuint pipeline = 0;
+        GLuint vertexArray = 0;
+        GLuint activeUnit = 0;
+        GLuint textures[MAX_TEXTURE_UNITS][TARGET_COUNT] = {};
+        GLuint samplers[MAX_TEXTURE_UNITS] = {};
+        GLuint drawFramebuffer = 0;
+        GLuint readFramebuffer = 0;
+        GLuint depthFunc = GL_LESS;
+        GLuint depthMask = 1;
+        GLuint cullFace = GL_BACK;
+        GLuint blendSource = GL_ONE;
+        GLuint blendDestination = GL_ZERO;
+        std::map<GLenum, bool> capabilities; // Absent means unknown
+        int viewport[4] = {};
+        bool viewportKnown = false; // The default viewport is the window size, which we don't know here
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    static GLStateStats& stats()
+    {
+        static GLStateStats s;
+        return s;
+    }
+
+    // Records the new value and returns true if the call has to be issued
+    static bool change(GLuint& current, GLuint value)
+    {
+        if (current == value)
+        {
+            stats().elided++;
+            return false;
+        }
+        stats().issued++;
+        current = value;
+        return true;
+    }
+
+    static void setCapability(GLenum capability, bool enabled)
+    {
+        State& s = state();
+        std::map<GLenum, bool>::iterator it = s.capabilities.find(capability);
+        if (it != s.capabilities.end() && it->second == enabled)
+        {
+            stats().elided++;
+            return;
+        }
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        stats().issued++;
+        s.capabilities[capability] = enabled;
+    }
+
+    // Slot for the texture targets this project binds; others are always issued
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_MULTISAMPLE: return 2;
+        case GL_TEXTURE_2D_ARRAY: return 3;
+        case GL_TEXTURE_3D: return 4;
+        default: return -1;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "IndexBuffer.h"
+
+#include <vector>
+#include <utility>
+
+// Where a mesh lives inside a shared vertex/index buffer. Indices are local to the mesh;
+// baseVertex is added to each one when drawing.
+struct MeshRange
+{
+    unsigned int indexOffset = 0; // In indices, not bytes
+    unsigned int indexCount = 0;
+    int baseVertex = 0;
+};
+
+// One vertex buffer and one index buffer behind one VAO, holding many meshes back to back.
+// Add() every mesh, then Upload() once; draw each range with glDrawElementsBaseVertex.
+// Because indices stay local to their mesh, 16-bit indices are used as long as no single
+// mesh has more than 65536 vertices.
+template <typename Layout>
+class GeometryArena
+{
+public:
+    typedef typename Layout::Vertex Vertex;
+
+    unsigned int VAO = 0;
+    unsigned int depthVAO = 0; // Positions only, for depth passes; 0 unless uploaded with a depth stream
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    GeometryArena() {}
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    GeometryArena(GeometryArena&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    GeometryArena& operator=(GeometryArena&& other) noexcept
+    {
+        if (this != &other)
+        {
+            deleteBuffers();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            largestMesh = other.largestMesh;
+            vertexCount = other.vertexCount;
+            indexCount = other.indexCount;
+            VAO = other.VAO;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            depthVAO = other.depthVAO;
+            depthVBO = other.depthVBO;
+            indexType = other.indexType;
+            other.VAO = other.VBO = other.EBO = other.depthVAO = other.depthVBO = 0;
+        }
+        return *this;
+    }
+
+    ~GeometryArena()
+    {
+        deleteBuffers();
+    }
+
+    MeshRange Add(const std::vector<Vertex>& meshVertices, const std::vector<unsigned int>& meshIndices)
+    {
+        MeshRange range;
+        range.indexOffset = (unsigned int)indices.size();
+        range.indexCount = (unsigned int)meshIndices.size();
+        range.baseVertex = (int)vertices.size();
+
+        vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        if (meshVertices.size() > largestMesh)
+            largestMesh = meshVertices.size();
+        return range;
+    }
+
+    // Creates the GL buffers from everything added so far and frees the CPU copies. With
+    // depthStream the positions are also copied into a packed buffer behind depthVAO, which
+    // shares the index buffer.
+    void Upload(bool depthStream = false)
+    {
+        deleteBuffers();
+        vertexCount = vertices.size();
+        indexCount = indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        GLState::BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        indexType = uploadIndices(GL_ELEMENT_ARRAY_BUFFER, indices, largestMesh);
+
+        Layout::SetupAttributes();
+
+        if (depthStream)
+        {
+            std::vector<typename Layout::Position> positions = Layout::ExtractPositions(vertices);
+            glGenVertexArrays(1, &depthVAO);
+            glGenBuffers(1, &depthVBO);
+            GLState::BindVertexArray(depthVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+            glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(typename Layout::Position), positions.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            Layout::SetupPositionStream();
+        }
+        GLState::BindVertexArray(0);
+
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    size_t VertexBytes() const
+    {
+        return vertexCount * sizeof(Vertex);
+    }
+
+    size_t IndexBytes() const
+    {
+        return indexCount * indexTypeSize(indexType);
+    }
+
+private:
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    size_t largestMesh = 0;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    unsigned int VBO = 0, EBO = 0;
+    unsigned int depthVBO = 0;
+
+    void deleteBuffers()
+    {
+        if (depthVAO != 0)
+        {
+            GLState::ForgetVertexArray(depthVAO);
+            glDeleteVertexArrays(1, &depthVAO);
+            glDeleteBuffers(1, &depthVBO);
+            depthVAO = depthVBO = 0;
+        }
+        if (VAO == 0)
+            return;
+        GLState::ForgetVertexArray(VAO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+};
+
+#endif
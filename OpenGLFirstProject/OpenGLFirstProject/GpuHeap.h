@@ -0,0 +1,616 @@
+#ifndef GPU_HEAP_H
+#define GPU_HEAP_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gpu_heap_detail
+{
+    inline uint32_t highestBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse(&index, value);
+        return (uint32_t)index;
+#else
+        return 31u - (uint32_t)__builtin_clz(value);
+#endif
+    }
+
+    inline uint32_t lowestBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (uint32_t)index;
+#else
+        return (uint32_t)__builtin_ctz(value);
+#endif
+    }
+}
+
+// Hands out ranges of [0, size) in O(1), TLSF style: free blocks sit in bins by size, two
+// levels deep (a power of two, then eight linear steps within it), with a bitmap per level so
+// finding a big enough bin is two bit scans. Allocations take the head of the first bin whose
+// every block fits and split off the tail; frees merge with free neighbours straight away.
+// Sizes and offsets are in whatever unit the caller picks.
+class OffsetAllocator
+{
+public:
+    static const uint32_t NONE = ~0u;
+
+    struct Allocation
+    {
+        uint32_t offset = NONE;
+        uint32_t node = NONE;
+    };
+
+    explicit OffsetAllocator(uint32_t size = 0)
+    {
+        Reset(size);
+    }
+
+    // Forgets every allocation and starts over with one free block of size
+    void Reset(uint32_t size)
+    {
+        capacity = size;
+        used = 0;
+        allocationCount = 0;
+        freeBlockCount = 0;
+        firstLevelBitmap = 0;
+        std::fill(secondLevelBitmaps, secondLevelBitmaps + FIRST_LEVEL_COUNT, 0u);
+        std::fill(binHeads, binHeads + BIN_COUNT, NONE);
+        nodes.clear();
+        unusedNodes.clear();
+        if (size > 0)
+            insertFree(newNode(0, size, NONE, NONE));
+    }
+
+    // Returns an allocation with offset NONE when no free block is big enough
+    Allocation Allocate(uint32_t size)
+    {
+        Allocation allocation;
+        if (size == 0)
+            size = 1;
+
+        // Any block in a bin found by findBin() fits. Failing that, a block in size's own bin
+        // may still be big enough, which matters when a request exactly fills what is left.
+        uint32_t bin = findBin(size);
+        uint32_t index = bin != NONE ? binHeads[bin] : searchBin(binOf(size), size);
+        if (index == NONE)
+            return allocation;
+        removeFree(index);
+        if (nodes[index].size > size)
+        {
+            // Keep the head, free the tail
+            Node& node = nodes[index];
+            uint32_t tail = newNode(node.offset + size, node.size - size, index, node.nextNeighbor);
+            if (nodes[tail].nextNeighbor != NONE)
+                nodes[nodes[tail].nextNeighbor].prevNeighbor = tail;
+            nodes[index].nextNeighbor = tail;
+            nodes[index].size = size;
+            insertFree(tail);
+        }
+        nodes[index].used = true;
+        used += nodes[index].size;
+        allocationCount++;
+
+        allocation.offset = nodes[index].offset;
+        allocation.node = index;
+        return allocation;
+    }
+
+    void Free(const Allocation& allocation)
+    {
+        if (allocation.node == NONE)
+            return;
+        uint32_t index = allocation.node;
+        nodes[index].used = false;
+        used -= nodes[index].size;
+        allocationCount--;
+
+        uint32_t prev = nodes[index].prevNeighbor;
+        if (prev != NONE && !nodes[prev].used)
+        {
+            removeFree(prev);
+            nodes[prev].size += nodes[index].size;
+            unlinkNeighbor(index);
+            index = prev;
+        }
+        uint32_t next = nodes[index].nextNeighbor;
+        if (next != NONE && !nodes[next].used)
+        {
+            removeFree(next);
+            nodes[index].size += nodes[next].size;
+            unlinkNeighbor(next);
+        }
+        insertFree(index);
+    }
+
+    uint32_t SizeOf(const Allocation& allocation) const
+    {
+        return allocation.node == NONE ? 0 : nodes[allocation.node].size;
+    }
+
+    uint32_t Capacity() const { return capacity; }
+    uint32_t Used() const { return used; }
+    uint32_t AllocationCount() const { return allocationCount; }
+    uint32_t FreeBlockCount() const { return freeBlockCount; }
+
+    // Size of the biggest free block; only the highest non-empty bin has to be looked at
+    uint32_t LargestFreeBlock() const
+    {
+        if (firstLevelBitmap == 0)
+            return 0;
+        uint32_t firstLevel = gpu_heap_detail::highestBit(firstLevelBitmap);
+        uint32_t secondLevel = gpu_heap_detail::highestBit(secondLevelBitmaps[firstLevel]);
+        uint32_t largest = 0;
+        for (uint32_t i = binHeads[firstLevel * SECOND_LEVEL_COUNT + secondLevel]; i != NONE; i = nodes[i].nextFree)
+            largest = std::max(largest, nodes[i].size);
+        return largest;
+    }
+
+private:
+    static const uint32_t SECOND_LEVEL_BITS = 3;
+    static const uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+    static const uint32_t FIRST_LEVEL_COUNT = 32;
+    static const uint32_t BIN_COUNT = FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT;
+
+    struct Node
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t prevNeighbor = NONE, nextNeighbor = NONE; // Adjacent blocks, by offset
+        uint32_t prevFree = NONE, nextFree = NONE;         // Bin list, while free
+        bool used = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes; // Node slots freed by merging, for reuse
+    uint32_t binHeads[BIN_COUNT];
+    uint32_t firstLevelBitmap = 0;
+    uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT];
+    uint32_t capacity = 0, used = 0;
+    uint32_t allocationCount = 0, freeBlockCount = 0;
+
+    // Bin holding blocks of exactly size: sizes below 8 get a bin each, then every power of
+    // two is split into eight equal steps
+    static uint32_t binOf(uint32_t size)
+    {
+        if (size < SECOND_LEVEL_COUNT)
+            return size;
+        uint32_t top = gpu_heap_detail::highestBit(size);
+        uint32_t firstLevel = top - SECOND_LEVEL_BITS + 1;
+        uint32_t secondLevel = (size >> (top - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+        return firstLevel * SECOND_LEVEL_COUNT + secondLevel;
+    }
+
+    // First non-empty bin whose smallest block is at least size, or NONE
+    uint32_t findBin(uint32_t size) const
+    {
+        // Round up to the next bin boundary so any block found fits
+        if (size >= SECOND_LEVEL_COUNT)
+        {
+            uint32_t step = (1u << (gpu_heap_detail::highestBit(size) - SECOND_LEVEL_BITS)) - 1;
+            if (size > ~0u - step)
+                return NONE;
+            size += step;
+        }
+        uint32_t bin = binOf(size);
+        uint32_t firstLevel = bin / SECOND_LEVEL_COUNT, secondLevel = bin % SECOND_LEVEL_COUNT;
+
+        uint32_t secondLevelMask = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if (secondLevelMask == 0)
+        {
+            if (firstLevel + 1 >= FIRST_LEVEL_COUNT)
+                return NONE;
+            uint32_t firstLevelMask = firstLevelBitmap & (~0u << (firstLevel + 1));
+            if (firstLevelMask == 0)
+                return NONE;
+            firstLevel = gpu_heap_detail::lowestBit(firstLevelMask);
+            secondLevelMask = secondLevelBitmaps[firstLevel];
+        }
+        return firstLevel * SECOND_LEVEL_COUNT + gpu_heap_detail::lowestBit(secondLevelMask);
+    }
+
+    // First block of at least size in one bin, or NONE
+    uint32_t searchBin(uint32_t bin, uint32_t size) const
+    {
+        for (uint32_t i = binHeads[bin]; i != NONE; i = nodes[i].nextFree)
+            if (nodes[i].size >= size)
+                return i;
+        return NONE;
+    }
+
+    uint32_t newNode(uint32_t offset, uint32_t size, uint32_t prevNeighbor, uint32_t nextNeighbor)
+    {
+        uint32_t index;
+        if (!unusedNodes.empty())
+        {
+            index = unusedNodes.back();
+            unusedNodes.pop_back();
+        }
+        else
+        {
+            index = (uint32_t)nodes.size();
+            nodes.emplace_back();
+        }
+        Node& node = nodes[index];
+        node = Node();
+        node.offset = offset;
+        node.size = size;
+        node.prevNeighbor = prevNeighbor;
+        node.nextNeighbor = nextNeighbor;
+        return index;
+    }
+
+    // Drops a node that has been merged into its previous neighbour
+    void unlinkNeighbor(uint32_t index)
+    {
+        Node& node = nodes[index];
+        if (node.prevNeighbor != NONE)
+            nodes[node.prevNeighbor].nextNeighbor = node.nextNeighbor;
+        if (node.nextNeighbor != NONE)
+            nodes[node.nextNeighbor].prevNeighbor = node.prevNeighbor;
+        unusedNodes.push_back(index);
+    }
+
+    void insertFree(uint32_t index)
+    {
+        uint32_t bin = binOf(nodes[index].size);
+        nodes[index].prevFree = NONE;
+        nodes[index].nextFree = binHeads[bin];
+        if (binHeads[bin] != NONE)
+            nodes[binHeads[bin]].prevFree = index;
+        binHeads[bin] = index;
+        firstLevelBitmap |= 1u << (bin / SECOND_LEVEL_COUNT);
+        secondLevelBitmaps[bin / SECOND_LEVEL_COUNT] |= 1u << (bin % SECOND_LEVEL_COUNT);
+        freeBlockCount++;
+    }
+
+    void removeFree(uint32_t index)
+    {
+        Node& node = nodes[index];
+        uint32_t bin = binOf(node.size);
+        if (node.prevFree != NONE)
+            nodes[node.prevFree].nextFree = node.nextFree;
+        else
+            binHeads[bin] = node.nextFree;
+        if (node.nextFree != NONE)
+            nodes[node.nextFree].prevFree = node.prevFree;
+        node.prevFree = node.nextFree = NONE;
+
+        if (binHeads[bin] == NONE)
+        {
+            uint32_t firstLevel = bin / SECOND_LEVEL_COUNT;
+            secondLevelBitmaps[firstLevel] &= ~(1u << (bin % SECOND_LEVEL_COUNT));
+            if (secondLevelBitmaps[firstLevel] == 0)
+                firstLevelBitmap &= ~(1u << firstLevel);
+        }
+        freeBlockCount--;
+    }
+};
+
+// Totals across every page of a GpuHeap
+struct GpuHeapStats
+{
+    unsigned int pages = 0;
+    unsigned int allocations = 0;
+    unsigned int freeBlocks = 0;
+    size_t capacity = 0;    // Bytes of buffer storage
+    size_t used = 0;        // Bytes handed out, rounded up to the heap's granularity
+    size_t largestFree = 0; // Biggest single allocation that fits without a new page
+    float worstFragmentation = 0.0f; // See Fragmentation()
+
+    float Utilization() const
+    {
+        return capacity > 0 ? (float)used / (float)capacity : 0.0f;
+    }
+
+    // Of the most fragmented page: 0 when its free space is one block, towards 1 as it
+    // splinters into small ones. Pages are measured on their own, as no block spans two.
+    float Fragmentation() const
+    {
+        return worstFragmentation;
+    }
+};
+
+// Static vertex and index data for many meshes in a few big buffer objects ("pages"). Each
+// page is carved up by an OffsetAllocator in units of the heap's granularity; a new page is
+// added when none has room, and a block bigger than a page gets a page of its own. Vertex
+// and index blocks can share a page: a buffer may be bound to both targets.
+//
+// Allocations are handles, looked up with Buffer() and Offset(), because Defragment() moves
+// blocks. Whoever has baked a buffer and offset into a VAO should compare Generation() with
+// the value they saw then and re-point their attributes when it has changed.
+//
+// Delete the GL buffers with Release() while the context is still current.
+class GpuHeap
+{
+public:
+    typedef unsigned int Handle;
+    static const Handle NONE = ~0u;
+
+    // granularity is the alignment of every block: a multiple of every vertex attribute and
+    // index size, and of anything else read straight from a block
+    explicit GpuHeap(size_t pageSize = 32 * 1024 * 1024, size_t granularity = 64)
+        : pageSize(pageSize), granularity(granularity)
+    {
+    }
+
+    GpuHeap(const GpuHeap&) = delete;
+    GpuHeap& operator=(const GpuHeap&) = delete;
+
+    ~GpuHeap()
+    {
+        Release();
+    }
+
+    // The heap every mesh allocates from
+    static GpuHeap& Shared()
+    {
+        static GpuHeap heap;
+        return heap;
+    }
+
+    // Returns NONE only when the GL can't create the storage
+    Handle Allocate(size_t bytes)
+    {
+        uint32_t units = (uint32_t)((std::max<size_t>(bytes, 1) + granularity - 1) / granularity);
+
+        Block block;
+        block.bytes = bytes;
+        for (block.page = 0; block.page < pages.size(); block.page++)
+        {
+            block.allocation = pages[block.page].allocator.Allocate(units);
+            if (block.allocation.offset != OffsetAllocator::NONE)
+                break;
+        }
+        if (block.page == pages.size())
+        {
+            block.page = addPage(std::max<size_t>(units, pageSize / granularity));
+            if (block.page == NONE)
+                return NONE;
+            block.allocation = pages[block.page].allocator.Allocate(units);
+        }
+        block.live = true;
+
+        Handle handle;
+        if (!unusedHandles.empty())
+        {
+            handle = unusedHandles.back();
+            unusedHandles.pop_back();
+            blocks[handle] = block;
+        }
+        else
+        {
+            handle = (Handle)blocks.size();
+            blocks.push_back(block);
+        }
+        return handle;
+    }
+
+    // Allocates a block and fills it
+    Handle Allocate(const void* data, size_t bytes)
+    {
+        Handle handle = Allocate(bytes);
+        if (handle != NONE)
+            Upload(handle, data, bytes);
+        return handle;
+    }
+
+    void Upload(Handle handle, const void* data, size_t bytes, size_t offset = 0)
+    {
+        // GL_COPY_WRITE_BUFFER leaves the VAO's element buffer and the other real bindings alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer(handle));
+        glBufferSubData(GL_COPY_WRITE_BUFFER, Offset(handle) + offset, bytes, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void Free(Handle handle)
+    {
+        // Meshes outliving Release() may still hand their blocks back
+        if (handle == NONE || handle >= blocks.size() || !blocks[handle].live)
+            return;
+        Block& block = blocks[handle];
+        pages[block.page].allocator.Free(block.allocation);
+        block.live = false;
+        unusedHandles.push_back(handle);
+    }
+
+    GLuint Buffer(Handle handle) const
+    {
+        return pages[blocks[handle].page].buffer;
+    }
+
+    // Byte offset of the block within Buffer()
+    size_t Offset(Handle handle) const
+    {
+        return (size_t)blocks[handle].allocation.offset * granularity;
+    }
+
+    size_t Size(Handle handle) const
+    {
+        return blocks[handle].bytes;
+    }
+
+    // Changes whenever Defragment() moves a block
+    unsigned int Generation() const
+    {
+        return generation;
+    }
+
+    // Packs the live blocks of every page with holes in it to the front of a fresh buffer,
+    // so the free space becomes one block at the end, and drops pages left with no blocks.
+    // The copies stay on the GPU. Every handle stays valid, but its Buffer() and Offset()
+    // may change.
+    void Defragment()
+    {
+        bool moved = false;
+        std::vector<Handle> pageBlocks;
+        for (uint32_t page = 0; page < pages.size(); page++)
+        {
+            Page& p = pages[page];
+            if (p.buffer == 0)
+                continue;
+            if (p.allocator.AllocationCount() == 0)
+            {
+                glDeleteBuffers(1, &p.buffer);
+                p.buffer = 0;
+                p.allocator.Reset(0);
+                continue;
+            }
+            if (isPacked(page))
+                continue;
+
+            pageBlocks.clear();
+            for (Handle h = 0; h < blocks.size(); h++)
+                if (blocks[h].live && blocks[h].page == page)
+                    pageBlocks.push_back(h);
+            std::sort(pageBlocks.begin(), pageBlocks.end(), [&](Handle a, Handle b)
+            {
+                return blocks[a].allocation.offset < blocks[b].allocation.offset;
+            });
+
+            GLuint compacted = createBuffer((size_t)p.allocator.Capacity() * granularity);
+            if (compacted == 0)
+                continue;
+            glBindBuffer(GL_COPY_READ_BUFFER, p.buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, compacted);
+
+            // From empty, allocating in offset order fills the page front to back
+            uint32_t capacity = p.allocator.Capacity();
+            std::vector<uint32_t> sizes(pageBlocks.size());
+            for (size_t i = 0; i < pageBlocks.size(); i++)
+                sizes[i] = p.allocator.SizeOf(blocks[pageBlocks[i]].allocation);
+            p.allocator.Reset(capacity);
+            for (size_t i = 0; i < pageBlocks.size(); i++)
+            {
+                Block& block = blocks[pageBlocks[i]];
+                size_t from = Offset(pageBlocks[i]);
+                block.allocation = p.allocator.Allocate(sizes[i]);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from, Offset(pageBlocks[i]), block.bytes);
+            }
+
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &p.buffer);
+            p.buffer = compacted;
+            moved = true;
+        }
+        if (moved)
+            generation++;
+    }
+
+    GpuHeapStats Stats() const
+    {
+        GpuHeapStats stats;
+        for (const Page& page : pages)
+        {
+            if (page.buffer == 0)
+                continue;
+            stats.pages++;
+            stats.allocations += page.allocator.AllocationCount();
+            stats.freeBlocks += page.allocator.FreeBlockCount();
+            stats.capacity += (size_t)page.allocator.Capacity() * granularity;
+            stats.used += (size_t)page.allocator.Used() * granularity;
+            stats.largestFree = std::max(stats.largestFree, (size_t)page.allocator.LargestFreeBlock() * granularity);
+
+            uint32_t free = page.allocator.Capacity() - page.allocator.Used();
+            if (free > 0)
+                stats.worstFragmentation = std::max(stats.worstFragmentation, 1.0f - (float)page.allocator.LargestFreeBlock() / (float)free);
+        }
+        return stats;
+    }
+
+    // Deletes every page; all handles become invalid
+    void Release()
+    {
+        for (Page& page : pages)
+            if (page.buffer != 0)
+                glDeleteBuffers(1, &page.buffer);
+        pages.clear();
+        blocks.clear();
+        unusedHandles.clear();
+    }
+
+private:
+    struct Page
+    {
+        GLuint buffer = 0;
+        OffsetAllocator allocator;
+    };
+
+    struct Block
+    {
+        uint32_t page = 0;
+        OffsetAllocator::Allocation allocation;
+        size_t bytes = 0;
+        bool live = false;
+    };
+
+    size_t pageSize;
+    size_t granularity;
+    std::vector<Page> pages;
+    std::vector<Block> blocks;
+    std::vector<Handle> unusedHandles;
+    unsigned int generation = 0;
+
+    GLuint createBuffer(size_t bytes)
+    {
+        // Drain errors left by earlier calls so only glBufferData's own counts
+        while (glGetError() != GL_NO_ERROR)
+            ;
+
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+        GLenum error = glGetError();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (error != GL_NO_ERROR)
+        {
+            std::cout << "ERROR::GPU_HEAP::PAGE_ALLOCATION_FAILED " << bytes << " bytes" << std::endl;
+            glDeleteBuffers(1, &buffer);
+            return 0;
+        }
+        return buffer;
+    }
+
+    // Returns the new page's index, reusing a page dropped by Defragment() if there is one
+    uint32_t addPage(size_t units)
+    {
+        GLuint buffer = createBuffer(units * granularity);
+        if (buffer == 0)
+            return NONE;
+        uint32_t index = 0;
+        while (index < pages.size() && pages[index].buffer != 0)
+            index++;
+        if (index == pages.size())
+            pages.emplace_back();
+        pages[index].buffer = buffer;
+        pages[index].allocator.Reset((uint32_t)units);
+        return index;
+    }
+
+    // True when the blocks leave no holes, i.e. all the free space is at the end
+    bool isPacked(uint32_t page) const
+    {
+        uint32_t end = 0;
+        for (const Block& block : blocks)
+            if (block.live && block.page == page)
+                end = std::max(end, block.allocation.offset + pages[page].allocator.SizeOf(block.allocation));
+        return end == pages[page].allocator.Used();
+    }
+};
+
+#endif
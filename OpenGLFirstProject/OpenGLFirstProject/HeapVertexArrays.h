@@ -0,0 +1,143 @@
+#ifndef HEAP_VERTEX_ARRAYS_H
+#define HEAP_VERTEX_ARRAYS_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "GpuHeap.h"
+
+#include <vector>
+#include <utility>
+#include <iostream>
+
+// VAOs over blocks of the shared GpuHeap. Every VAO reads one of the vertex blocks through its
+// own attribute setup, and all of them share the index block. GpuHeap::Defragment() can move
+// the blocks, so Bind() re-points the VAOs whenever GpuHeap::Generation() has changed.
+//
+// Owns the VAOs and the blocks, so it can be moved but not copied. Destroy it while the
+// context is still current and before GpuHeap::Shared().Release().
+class HeapVertexArrays
+{
+public:
+    // Sets up the bound VAO's attributes for vertex data starting base bytes into GL_ARRAY_BUFFER
+    typedef void (*AttributeSetup)(size_t base);
+
+    HeapVertexArrays() = default;
+
+    HeapVertexArrays(const HeapVertexArrays&) = delete;
+    HeapVertexArrays& operator=(const HeapVertexArrays&) = delete;
+
+    HeapVertexArrays(HeapVertexArrays&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    HeapVertexArrays& operator=(HeapVertexArrays&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            blocks = std::move(other.blocks);
+            arrays = std::move(other.arrays);
+            generation = other.generation;
+            other.blocks.clear();
+            other.arrays.clear();
+        }
+        return *this;
+    }
+
+    ~HeapVertexArrays()
+    {
+        Release();
+    }
+
+    // Takes over heapBlocks, the index block first and then the vertex blocks. If any of them
+    // is GpuHeap::NONE the allocation failed: it's reported as ERROR::<owner>::..., the rest
+    // are freed and false is returned.
+    bool Adopt(const char* owner, const std::vector<GpuHeap::Handle>& heapBlocks)
+    {
+        Release();
+        for (GpuHeap::Handle block : heapBlocks)
+        {
+            if (block != GpuHeap::NONE)
+                continue;
+            std::cout << "ERROR::" << owner << "::HEAP_ALLOCATION_FAILED" << std::endl;
+            GpuHeap& heap = GpuHeap::Shared();
+            for (GpuHeap::Handle other : heapBlocks)
+                heap.Free(other);
+            return false;
+        }
+        blocks = heapBlocks;
+        return true;
+    }
+
+    // Creates a VAO reading vertex block block (an index into the adopted blocks, so 1 for
+    // the first vertex block) through setup. Leaves it bound.
+    GLuint AddArray(unsigned int block, AttributeSetup setup)
+    {
+        Array array;
+        glGenVertexArrays(1, &array.vao);
+        array.block = block;
+        array.setup = setup;
+        arrays.push_back(array);
+        generation = GpuHeap::Shared().Generation();
+        pointAtBlock(array);
+        return array.vao;
+    }
+
+    // Binds vao, first re-pointing every VAO if the blocks have moved
+    void Bind(GLuint vao)
+    {
+        if (!arrays.empty() && generation != GpuHeap::Shared().Generation())
+        {
+            generation = GpuHeap::Shared().Generation();
+            for (const Array& array : arrays)
+                pointAtBlock(array);
+        }
+        GLState::BindVertexArray(vao);
+    }
+
+    // Byte offset of the index block in its buffer, to add to the draw calls' index offsets
+    size_t IndexOffset() const
+    {
+        return blocks.empty() ? 0 : GpuHeap::Shared().Offset(blocks[0]);
+    }
+
+    void Release()
+    {
+        for (Array& array : arrays)
+        {
+            GLState::ForgetVertexArray(array.vao);
+            glDeleteVertexArrays(1, &array.vao);
+        }
+        arrays.clear();
+
+        GpuHeap& heap = GpuHeap::Shared();
+        for (GpuHeap::Handle block : blocks)
+            heap.Free(block);
+        blocks.clear();
+    }
+
+private:
+    struct Array
+    {
+        GLuint vao = 0;
+        unsigned int block = 0;
+        AttributeSetup setup = nullptr;
+    };
+
+    std::vector<GpuHeap::Handle> blocks; // Index block first
+    std::vector<Array> arrays;
+    unsigned int generation = 0;         // GpuHeap::Generation() when the VAOs were last pointed at the blocks
+
+    void pointAtBlock(const Array& array)
+    {
+        GpuHeap& heap = GpuHeap::Shared();
+        GLState::BindVertexArray(array.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, heap.Buffer(blocks[array.block]));
+        array.setup(heap.Offset(blocks[array.block]));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, heap.Buffer(blocks[0]));
+    }
+};
+
+#endif
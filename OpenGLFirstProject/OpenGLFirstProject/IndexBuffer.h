@@ -0,0 +1,112 @@
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Number of vertices 16-bit indices can address
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+// Smallest index type that can address vertexCount vertices
+inline GLenum indexTypeFor(size_t vertexCount)
+{
+    return vertexCount <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexTypeSize(GLenum type)
+{
+    return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Fills the buffer bound to target with indices, narrowed to 16 bits when vertexCount allows.
+// Returns the index type to draw with.
+inline GLenum uploadIndices(GLenum target, const std::vector<unsigned int>& indices, size_t vertexCount, GLenum usage = GL_STATIC_DRAW)
+{
+    GLenum type = indexTypeFor(vertexCount);
+    if (type == GL_UNSIGNED_SHORT)
+    {
+        std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+        glBufferData(target, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), usage);
+    }
+    else
+    {
+        glBufferData(target, indices.size() * sizeof(unsigned int), indices.data(), usage);
+    }
+    return type;
+}
+
+// Appends indices to bytes as they would be uploaded, narrowed to 16 bits when vertexCount
+// allows. Returns the index type to draw with.
+inline GLenum packIndices(const std::vector<unsigned int>& indices, size_t vertexCount, std::vector<unsigned char>& bytes)
+{
+    GLenum type = indexTypeFor(vertexCount);
+    size_t start = bytes.size();
+    bytes.resize(start + indices.size() * indexTypeSize(type));
+    if (type == GL_UNSIGNED_SHORT)
+    {
+        uint16_t* out = (uint16_t*)(bytes.data() + start);
+        for (size_t i = 0; i < indices.size(); i++)
+            out[i] = (uint16_t)indices[i];
+    }
+    else if (!indices.empty())
+    {
+        std::memcpy(bytes.data() + start, indices.data(), indices.size() * sizeof(unsigned int));
+    }
+    return type;
+}
+
+template <typename VertexT>
+struct MeshChunk
+{
+    std::vector<VertexT> vertices;
+    std::vector<unsigned int> indices;
+};
+
+// Splits an indexed triangle list into chunks of at most maxVertices vertices each, so every
+// chunk can use 16-bit indices. Triangles stay in their original order; vertices shared
+// across a chunk boundary are duplicated.
+template <typename VertexT>
+std::vector<MeshChunk<VertexT>> splitForShortIndices(const std::vector<VertexT>& vertices, const std::vector<unsigned int>& indices,
+    size_t maxVertices = MAX_SHORT_INDEX_VERTICES)
+{
+    const unsigned int NONE = ~0u;
+    std::vector<MeshChunk<VertexT>> chunks;
+    std::vector<unsigned int> chunkOf(vertices.size(), NONE); // Last chunk each vertex was copied into
+    std::vector<unsigned int> remap(vertices.size());         // Its index within that chunk
+
+    chunks.emplace_back();
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        unsigned int current = (unsigned int)(chunks.size() - 1);
+
+        size_t needed = 0;
+        for (int corner = 0; corner < 3; corner++)
+            if (chunkOf[indices[t + corner]] != current)
+                needed++;
+        if (chunks.back().vertices.size() + needed > maxVertices)
+        {
+            chunks.emplace_back();
+            current++;
+        }
+
+        MeshChunk<VertexT>& chunk = chunks.back();
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int v = indices[t + corner];
+            if (chunkOf[v] != current)
+            {
+                chunkOf[v] = current;
+                remap[v] = (unsigned int)chunk.vertices.size();
+                chunk.vertices.push_back(vertices[v]);
+            }
+            chunk.indices.push_back(remap[v]);
+        }
+    }
+    return chunks;
+}
+
+#endif
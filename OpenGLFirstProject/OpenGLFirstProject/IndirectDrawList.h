@@ -0,0 +1,260 @@
+#ifndef INDIRECT_DRAW_LIST_H
+#define INDIRECT_DRAW_LIST_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "Mesh.h"
+#include "GeometryArena.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <vector>
+#include <utility>
+
+// Layout of one record in a GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the GL layout");
+
+inline bool multiDrawIndirectSupported()
+{
+    return glVersionAtLeast(4, 3) || hasGLExtension("GL_ARB_multi_draw_indirect");
+}
+
+// Draws every mesh of a GeometryArena with a few multi-draw calls: the meshes are grouped
+// by material (same textures), and each group is one glMultiDrawElementsIndirect, or one
+// glMultiDrawElementsBaseVertex where indirect draws aren't available (GL 3.3).
+//
+// Materials are separate GL_TEXTURE_2D objects bound per group, so a group is as far as one
+// call can reach; a single call for the whole model would need the textures in an array or
+// bindless handles that a per-draw index could select.
+template <typename Layout>
+class IndirectDrawList
+{
+public:
+    IndirectDrawList() {}
+
+    IndirectDrawList(const IndirectDrawList&) = delete;
+    IndirectDrawList& operator=(const IndirectDrawList&) = delete;
+
+    IndirectDrawList(IndirectDrawList&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    IndirectDrawList& operator=(IndirectDrawList&& other) noexcept
+    {
+        if (this != &other)
+        {
+            deleteBuffers();
+            batches = std::move(other.batches);
+            commands = std::move(other.commands);
+            counts = std::move(other.counts);
+            offsets = std::move(other.offsets);
+            baseVertices = std::move(other.baseVertices);
+            commandOf = std::move(other.commandOf);
+            dirty = other.dirty;
+            VAO = other.VAO;
+            indexType = other.indexType;
+            indirect = other.indirect;
+            indirectBuffer = other.indirectBuffer;
+            other.indirectBuffer = 0;
+        }
+        return *this;
+    }
+
+    ~IndirectDrawList()
+    {
+        deleteBuffers();
+    }
+
+    // Record one command per mesh. The meshes must all be ranges of arena, which must
+    // already be uploaded.
+    void Build(const GeometryArena<Layout>& arena, const std::vector<BasicMesh<Layout>>& meshes)
+    {
+        deleteBuffers();
+        batches.clear();
+        commands.clear();
+        commandOf.assign(meshes.size(), 0);
+        dirty = false;
+        VAO = arena.VAO;
+        indexType = arena.indexType;
+        indirect = multiDrawIndirectSupported();
+
+        // Group meshes by material, keeping first-seen order
+        std::vector<std::vector<unsigned int>> groups;
+        std::vector<unsigned int> groupMesh;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            unsigned int group = 0;
+            while (group < groupMesh.size() && !sameTextures(meshes[groupMesh[group]], meshes[i]))
+                group++;
+            if (group == groupMesh.size())
+            {
+                groups.emplace_back();
+                groupMesh.push_back(i);
+            }
+            groups[group].push_back(i);
+        }
+
+        for (unsigned int group = 0; group < groups.size(); group++)
+        {
+            Batch batch;
+            batch.materialMesh = groupMesh[group];
+            batch.first = (unsigned int)commands.size();
+            batch.count = (unsigned int)groups[group].size();
+            batches.push_back(batch);
+
+            for (unsigned int mesh : groups[group])
+            {
+                commandOf[mesh] = (unsigned int)commands.size();
+                MeshRange range = meshes[mesh].LodRange(0);
+                DrawElementsIndirectCommand command;
+                command.count = range.indexCount;
+                command.instanceCount = 1;
+                command.firstIndex = range.indexOffset;
+                command.baseVertex = range.baseVertex;
+                command.baseInstance = 0;
+                commands.push_back(command);
+            }
+        }
+
+        if (indirect)
+        {
+            glGenBuffers(1, &indirectBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        else
+        {
+            counts.clear();
+            offsets.clear();
+            baseVertices.clear();
+            for (const DrawElementsIndirectCommand& command : commands)
+            {
+                counts.push_back((GLsizei)command.count);
+                offsets.push_back((const void*)(command.firstIndex * indexTypeSize(indexType)));
+                baseVertices.push_back(command.baseVertex);
+            }
+        }
+    }
+
+    // Point a mesh's command at another index range of the arena, e.g. a different LOD.
+    // Changes go to the GPU together on the next Draw().
+    void SelectRange(unsigned int mesh, const MeshRange& range)
+    {
+        DrawElementsIndirectCommand& command = commands[commandOf[mesh]];
+        if (command.firstIndex == range.indexOffset && command.count == range.indexCount)
+            return;
+        command.count = range.indexCount;
+        command.firstIndex = range.indexOffset;
+        if (indirect)
+        {
+            dirty = true;
+        }
+        else
+        {
+            counts[commandOf[mesh]] = (GLsizei)range.indexCount;
+            offsets[commandOf[mesh]] = (const void*)(range.indexOffset * indexTypeSize(indexType));
+        }
+    }
+
+    // meshes must be the same list Build() was given
+    void Draw(Shader& shader, std::vector<BasicMesh<Layout>>& meshes)
+    {
+        GLState::BindVertexArray(VAO);
+        if (indirect)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            if (dirty)
+            {
+                glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+                dirty = false;
+            }
+        }
+
+        for (unsigned int i = 0; i < batches.size(); i++)
+        {
+            const Batch& batch = batches[i];
+            meshes[batch.materialMesh].BindMaterial(shader);
+            if (indirect)
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, indexType,
+                    (const void*)(batch.first * sizeof(DrawElementsIndirectCommand)), batch.count, 0);
+            }
+            else
+            {
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, &counts[batch.first], indexType,
+                    &offsets[batch.first], batch.count, &baseVertices[batch.first]);
+            }
+        }
+    }
+
+    unsigned int BatchCount() const
+    {
+        return (unsigned int)batches.size();
+    }
+
+    unsigned int CommandCount() const
+    {
+        return (unsigned int)commands.size();
+    }
+
+    bool UsesIndirectDraws() const
+    {
+        return indirect;
+    }
+
+private:
+    // A run of commands sharing one material; materialMesh is any mesh using it
+    struct Batch
+    {
+        unsigned int materialMesh;
+        unsigned int first;
+        unsigned int count;
+    };
+
+    std::vector<Batch> batches;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // Fallback (glMultiDrawElementsBaseVertex) arguments, in command order
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    std::vector<unsigned int> commandOf; // Command index for each mesh
+    bool dirty = false;                  // Commands changed since the last upload
+
+    GLuint VAO = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    bool indirect = false;
+    GLuint indirectBuffer = 0;
+
+    static bool sameTextures(const BasicMesh<Layout>& a, const BasicMesh<Layout>& b)
+    {
+        if (a.textures.size() != b.textures.size())
+            return false;
+        for (unsigned int i = 0; i < a.textures.size(); i++)
+            if (a.textures[i].id != b.textures[i].id || a.textures[i].type != b.textures[i].type)
+                return false;
+        return true;
+    }
+
+    void deleteBuffers()
+    {
+        if (indirectBuffer != 0)
+            glDeleteBuffers(1, &indirectBuffer);
+        indirectBuffer = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// First attribute location of the per-instance model matrix. A full mat4 takes 3-6:
+// layout (location = 3) in mat4 aInstanceModel;
+// the packed 3x4 form takes 3-5, one row each (INSTANCE_MATRIX_3X4 in shader.vert).
+const GLuint INSTANCE_MATRIX_ATTRIBUTE = 3;
+
+enum class InstanceFormat
+{
+    Matrix4x4, // 64 bytes per instance
+    Matrix3x4  // 48 bytes: the bottom row of an affine transform is always 0 0 0 1
+};
+
+// Per-instance model matrices for DrawInstanced(). Refill it as often as needed with
+// Update(): the storage is orphaned first, so a refill never waits for draws still reading
+// the previous contents, and it only reallocates when it has to grow.
+class InstanceBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    explicit InstanceBuffer(InstanceFormat format = InstanceFormat::Matrix4x4) : format(format)
+    {
+        glGenBuffers(1, &ID);
+    }
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    InstanceBuffer(InstanceBuffer&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    InstanceBuffer& operator=(InstanceBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (ID != 0)
+                glDeleteBuffers(1, &ID);
+            ID = other.ID;
+            format = other.format;
+            count = other.count;
+            capacity = other.capacity;
+            packed = std::move(other.packed);
+            other.ID = 0;
+            other.count = other.capacity = 0;
+        }
+        return *this;
+    }
+
+    ~InstanceBuffer()
+    {
+        if (ID != 0)
+            glDeleteBuffers(1, &ID);
+    }
+
+    void Update(const glm::mat4* transforms, size_t instanceCount)
+    {
+        const void* data = transforms;
+        if (format == InstanceFormat::Matrix3x4)
+        {
+            packed.resize(instanceCount * 3);
+            for (size_t i = 0; i < instanceCount; i++)
+                for (int row = 0; row < 3; row++)
+                    packed[i * 3 + row] = glm::vec4(transforms[i][0][row], transforms[i][1][row], transforms[i][2][row], transforms[i][3][row]);
+            data = packed.data();
+        }
+
+        size_t bytes = instanceCount * Stride();
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        if (bytes > capacity)
+        {
+            capacity = bytes;
+            glBufferData(GL_ARRAY_BUFFER, capacity, data, GL_STREAM_DRAW);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        count = instanceCount;
+    }
+
+    void Update(const std::vector<glm::mat4>& transforms)
+    {
+        Update(transforms.data(), transforms.size());
+    }
+
+    // Points the instance attributes of the bound VAO at this buffer, starting at instance first
+    void BindAttributes(unsigned int first = 0) const
+    {
+        GLuint columns = format == InstanceFormat::Matrix3x4 ? 3 : 4;
+        GLsizei stride = (GLsizei)Stride();
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        for (GLuint i = 0; i < columns; i++)
+        {
+            GLuint location = INSTANCE_MATRIX_ATTRIBUTE + i;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(first * Stride() + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Instances written by the last Update()
+    size_t Count() const
+    {
+        return count;
+    }
+
+    size_t Stride() const
+    {
+        return format == InstanceFormat::Matrix3x4 ? 3 * sizeof(glm::vec4) : sizeof(glm::mat4);
+    }
+
+    InstanceFormat Format() const
+    {
+        return format;
+    }
+
+    // Defines a vertex shader needs to read this format
+    ShaderDefines Defines() const
+    {
+        ShaderDefines defines;
+        defines.push_back(std::make_pair(std::string("INSTANCED"), std::string("1")));
+        if (format == InstanceFormat::Matrix3x4)
+            defines.push_back(std::make_pair(std::string("INSTANCE_MATRIX_3X4"), std::string("1")));
+        return defines;
+    }
+
+private:
+    InstanceFormat format = InstanceFormat::Matrix4x4;
+    size_t count = 0;
+    size_t capacity = 0; // Bytes allocated on the GPU
+    std::vector<glm::vec4> packed;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef LIGHT_TABLE_H
+#define LIGHT_TABLE_H
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "FrameData.h"
+#include "StreamingBuffer.h"
+
+#include <vector>
+
+// Point lights kept as a structure of arrays, so each attribute is one contiguous block that
+// goes to the shader in a single glUniform3fv call (shaders declare matching
+// "uniform vec3 lightPositions[N]; uniform vec3 lightColors[N];" arrays), or is streamed as
+// the LightData uniform block (lightData.glsl).
+struct LightTable
+{
+    std::vector<glm::vec3> Positions;
+    std::vector<glm::vec3> Colors;
+
+    void Add(glm::vec3 position, glm::vec3 color)
+    {
+        Positions.push_back(position);
+        Colors.push_back(color);
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)Positions.size();
+    }
+
+    // Colors rarely change, so that upload is normally skipped by the shader's shadow copy
+    void Upload(const Shader& shader, UniformHandle positionsUniform, UniformHandle colorsUniform) const
+    {
+        if (Positions.empty())
+            return;
+        shader.setVec3Array(positionsUniform, Positions.data(), (GLsizei)Positions.size());
+        shader.setVec3Array(colorsUniform, Colors.data(), (GLsizei)Colors.size());
+    }
+
+    // Writes the LightData block, sized for Count() lights, and binds it to LIGHT_DATA_BINDING
+    void Stream(StreamingBuffer& stream) const
+    {
+        if (Positions.empty())
+            return;
+        // std140 pads every vec3 array element to a vec4
+        std::vector<glm::vec4> block;
+        block.reserve(Positions.size() * 2);
+        for (const glm::vec3& position : Positions)
+            block.push_back(glm::vec4(position, 0.0f));
+        for (const glm::vec3& color : Colors)
+            block.push_back(glm::vec4(color, 0.0f));
+
+        size_t bytes = block.size() * sizeof(glm::vec4);
+        GLintptr offset = stream.Write(block.data(), bytes);
+        if (offset >= 0)
+            glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, stream.ID, offset, bytes);
+    }
+};
+
+#endif
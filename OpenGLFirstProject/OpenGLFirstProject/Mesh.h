@@ -5,47 +5,292 @@
 #include <glm/glm.hpp>
 
 #include "Shader.h"
+#include "GLState.h"
+#include "VertexLayout.h"
+#include "IndexBuffer.h"
+#include "GeometryArena.h"
+#include "GpuHeap.h"
+#include "HeapVertexArrays.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "Frustum.h"
+#include "Bounds.h"
+#include "InstanceBuffer.h"
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
 using namespace std;
 
-struct Vertex {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-};
-
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
-class Mesh {
+// Set by meshes with quantized positions, for shaders built with POSITION_QUANTIZED
+constexpr UniformHandle POSITION_OFFSET_UNIFORM("positionOffset");
+constexpr UniformHandle POSITION_SCALE_UNIFORM("positionScale");
+
+// Owns its VAO and its blocks of the shared GpuHeap, so it can be moved but not copied.
+// Destroy meshes while the context is still current. Layout (see VertexLayout.h) fixes the
+// vertex format.
+// A mesh can instead be a range of a GeometryArena, which then owns the GL objects.
+template <typename Layout>
+class BasicMesh {
 public:
-    // Mesh data
+    typedef typename Layout::Vertex Vertex;
+
+    // Mesh data. vertices and indices are empty after ReleaseCPUData().
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
-    unsigned int VAO;
+    PositionQuantization quantization;
+    unsigned int VAO = 0;
+    unsigned int depthVAO = 0; // Positions only (see DrawDepth); 0 when there's no depth stream
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT; // GL_UNSIGNED_SHORT when there are few enough vertices
+    MeshRange range;                    // Where in the (possibly shared) buffers this mesh lives
+
+    // Levels of detail, full detail first; there's always at least that one. indexCount and
+    // range cover level 0.
+    vector<MeshLod> lods;
+
+    // Model-space extent, for culling and for picking a level; empty unless the loader set it
+    BoundingBox bounds;
+    BoundingSphere boundingSphere;
+
+    // Clusters of level 0, for DrawVisibleClusters(); empty unless the loader built them
+    vector<Meshlet> meshlets;
+
+    // Pass the vectors with std::move to hand them over without copying. depthStream adds a
+    // packed copy of the positions for depth and shadow passes.
+    BasicMesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+        const PositionQuantization& quantization = PositionQuantization(), bool keepCPUData = true, bool depthStream = false)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), quantization(quantization)
+    {
+        indexCount = (unsigned int)this->indices.size();
+        range.indexCount = indexCount;
+        lods.resize(1);
+        lods[0].indexCount = indexCount;
+        setupMesh(depthStream);
+        resolveSamplerUniforms();
+        if (!keepCPUData)
+            ReleaseCPUData();
+    }
+
+    // A mesh drawn from a range of an uploaded arena. vertices and indices stay empty.
+    BasicMesh(const GeometryArena<Layout>& arena, const MeshRange& range, vector<Texture> textures,
+        const PositionQuantization& quantization = PositionQuantization())
+        : textures(std::move(textures)), quantization(quantization), range(range)
+    {
+        VAO = arena.VAO;
+        depthVAO = arena.depthVAO;
+        indexCount = range.indexCount;
+        lods.resize(1);
+        lods[0].indexCount = indexCount;
+        indexType = arena.indexType;
+        ownsBuffers = false;
+        resolveSamplerUniforms();
+    }
+
+    BasicMesh(const BasicMesh&) = delete;
+    BasicMesh& operator=(const BasicMesh&) = delete;
+
+    BasicMesh(BasicMesh&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    BasicMesh& operator=(BasicMesh&& other) noexcept
+    {
+        if (this != &other)
+        {
+            deleteBuffers();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            samplerUniforms = std::move(other.samplerUniforms);
+            quantization = other.quantization;
+            VAO = other.VAO;
+            depthVAO = other.depthVAO;
+            arrays = std::move(other.arrays);
+            indexCount = other.indexCount;
+            indexType = other.indexType;
+            range = other.range;
+            lods = std::move(other.lods);
+            bounds = other.bounds;
+            boundingSphere = other.boundingSphere;
+            meshlets = std::move(other.meshlets);
+            ownsBuffers = other.ownsBuffers;
+            other.VAO = other.depthVAO = 0;
+            other.indexCount = 0;
+        }
+        return *this;
+    }
+
+    ~BasicMesh()
+    {
+        deleteBuffers();
+    }
+
+    // Free the CPU copies of the vertex and index data once they live on the GPU
+    void ReleaseCPUData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // Replace the level list; the index buffer must already hold every level's indices
+    void SetLods(vector<MeshLod> levels)
+    {
+        lods = std::move(levels);
+        indexCount = lods[0].indexCount;
+        range.indexCount = indexCount;
+    }
+
+    // Index range of a level within the (possibly shared) index buffer
+    MeshRange LodRange(unsigned int level) const
+    {
+        const MeshLod& lod = lods[std::min<size_t>(level, lods.size() - 1)];
+        MeshRange r = range;
+        r.indexOffset += lod.indexOffset;
+        r.indexCount = lod.indexCount;
+        return r;
+    }
+
+    void Draw(Shader& shader, unsigned int level = 0)
+    {
+        if (VAO == 0)
+            return;
+        BindMaterial(shader);
+
+        // Draw mesh. The VAO stays bound; the next draw binds its own (or elides the bind,
+        // as for every mesh sharing an arena)
+        MeshRange r = LodRange(level);
+        bindVertexArray(VAO);
+        if (ownsBuffers)
+            glDrawElements(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset));
+        else
+            glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset), r.baseVertex);
+    }
+
+    // Draws count copies of a level in one call, each with its model matrix from instances
+    // (the shader reads it from the instance attributes instead of the model uniform)
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count, unsigned int level = 0)
+    {
+        if (count == 0 || VAO == 0)
+            return;
+        BindMaterial(shader);
+
+        MeshRange r = LodRange(level);
+        bindVertexArray(VAO);
+        instances.BindAttributes();
+        if (ownsBuffers)
+            glDrawElementsInstanced(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset), count);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset), count, r.baseVertex);
+    }
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // Draws a level for a depth or shadow pass: positions only, no material. Uses the packed
+    // position stream when there is one, which fetches a half (compact layout) to a third
+    // (float layout) of the bytes the full vertices would.
+    void DrawDepth(Shader& shader, unsigned int level = 0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        if (VAO == 0)
+            return;
+        if (Layout::PositionFormat::Quantized)
+        {
+            shader.set(POSITION_OFFSET_UNIFORM, quantization.Offset);
+            shader.set(POSITION_SCALE_UNIFORM, quantization.Scale);
+        }
 
-        setupMesh();
+        MeshRange r = LodRange(level);
+        bindVertexArray(depthVAO != 0 ? depthVAO : VAO);
+        if (ownsBuffers)
+            glDrawElements(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset));
+        else
+            glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, indexType, indexPointer(r.indexOffset), r.baseVertex);
     }
 
-    void Draw(Shader& shader)
+    // Draws level 0, skipping the clusters that are outside the frustum or face away from the
+    // camera; both must be given in this mesh's model space. Draws everything when the mesh has
+    // no clusters. Returns the number of triangles submitted.
+    unsigned int DrawVisibleClusters(Shader& shader, const Frustum& frustum, const glm::vec3& cameraPosition)
+    {
+        if (VAO == 0)
+            return 0;
+        if (meshlets.empty())
+        {
+            Draw(shader);
+            return indexCount / 3;
+        }
+
+        visibleRanges.clear();
+        unsigned int triangles = cullMeshlets(meshlets, frustum, cameraPosition, visibleRanges);
+        if (visibleRanges.empty())
+            return 0;
+
+        rangeCounts.clear();
+        rangeOffsets.clear();
+        for (const IndexRange& visible : visibleRanges)
+        {
+            rangeCounts.push_back((GLsizei)visible.count);
+            rangeOffsets.push_back(indexPointer(range.indexOffset + visible.first));
+        }
+
+        BindMaterial(shader);
+        bindVertexArray(VAO);
+        if (ownsBuffers)
+        {
+            glMultiDrawElements(GL_TRIANGLES, rangeCounts.data(), indexType, rangeOffsets.data(), (GLsizei)rangeCounts.size());
+        }
+        else
+        {
+            rangeBaseVertices.assign(rangeCounts.size(), range.baseVertex);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, rangeCounts.data(), indexType, rangeOffsets.data(),
+                (GLsizei)rangeCounts.size(), rangeBaseVertices.data());
+        }
+        return triangles;
+    }
+
+    // Bind this mesh's textures and set its per-mesh uniforms, without drawing
+    void BindMaterial(Shader& shader)
+    {
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            shader.set(samplerUniforms[i], (int)i);
+            GLState::BindTexture(i, GL_TEXTURE_2D, textures[i].id);
+        }
+        if (Layout::PositionFormat::Quantized)
+        {
+            shader.set(POSITION_OFFSET_UNIFORM, quantization.Offset);
+            shader.set(POSITION_SCALE_UNIFORM, quantization.Scale);
+        }
+    }
+
+private:
+    // Render data: blocks of GpuHeap::Shared() unless the mesh is part of an arena
+    HeapVertexArrays arrays; // VAO and depthVAO over this mesh's heap blocks; empty for arena ranges
+    bool ownsBuffers = true;
+
+    // "material.texture_diffuseN" etc. for each texture, built once instead of on every draw
+    vector<UniformHandle> samplerUniforms;
+
+    // Scratch space for DrawVisibleClusters(), kept to avoid allocating every frame
+    vector<IndexRange> visibleRanges;
+    vector<GLsizei> rangeCounts;
+    vector<const void*> rangeOffsets;
+    vector<GLint> rangeBaseVertices;
+
+    void resolveSamplerUniforms()
     {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i);
             // Retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -54,47 +299,62 @@ public:
             else if (name == "texture_specular")
                 number = to_string(specularNr++);
 
-            shader.setInt(("material." + name + number).c_str(), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            samplerUniforms.push_back(UniformHandle("material." + name + number));
         }
-        glActiveTexture(GL_TEXTURE0);
-
-        // Draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
     }
-
-private:
-    // Render data
-    unsigned int VBO, EBO;
-    void setupMesh()
+    void deleteBuffers()
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        if (VAO == 0 || !ownsBuffers)
+            return;
+        arrays.Release();
+        VAO = depthVAO = 0;
+    }
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // Index buffer offset of index first, for the draw calls; the heap block's start is
+    // added for meshes that own their blocks
+    const void* indexPointer(unsigned int first) const
+    {
+        size_t base = ownsBuffers ? arrays.IndexOffset() : 0;
+        return (const void*)(base + first * indexTypeSize(indexType));
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // Binds vao, first re-pointing the VAOs if GpuHeap::Defragment() has moved the blocks
+    void bindVertexArray(unsigned int vao)
+    {
+        arrays.Bind(vao);
+    }
 
-        // Vertex positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // The vertices, indices and (with depthStream) packed positions each get a block of the
+    // shared heap instead of a buffer object of their own
+    void setupMesh(bool depthStream)
+    {
+        GpuHeap& heap = GpuHeap::Shared();
+        vector<unsigned char> indexBytes;
+        indexType = packIndices(indices, vertices.size(), indexBytes);
+        vector<GpuHeap::Handle> blocks;
+        blocks.push_back(heap.Allocate(indexBytes.data(), indexBytes.size()));
+        blocks.push_back(heap.Allocate(vertices.data(), vertices.size() * sizeof(Vertex)));
 
-        // Vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // Depth passes read positions only; give them their own tightly packed block so every
+        // fetched cache line is all positions. The indices are shared.
+        if (depthStream)
+        {
+            vector<typename Layout::Position> positions = Layout::ExtractPositions(vertices);
+            blocks.push_back(heap.Allocate(positions.data(), positions.size() * sizeof(typename Layout::Position)));
+        }
 
-        // Vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // Without its blocks the mesh keeps VAO 0 and draws nothing
+        if (!arrays.Adopt("MESH", blocks))
+            return;
 
-        glBindVertexArray(0);
+        // Positions, normals and texture coords, in whatever format the layout stores them
+        VAO = arrays.AddArray(1, &Layout::SetupAttributes);
+        if (depthStream)
+            depthVAO = arrays.AddArray(2, &Layout::SetupPositionStream);
+        GLState::BindVertexArray(0);
     }
 };
 
+typedef BasicMesh<FloatVertexLayout> Mesh;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,277 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Load-time reordering of indexed triangle lists for the GPU's post-transform vertex cache,
+// for overdraw, and for vertex fetch locality. Based on Sander, Nehab & Barczak, "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007).
+
+// FIFO cache size assumed when optimizing and measuring
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// ACMR: vertex shader runs per triangle (0.5 is ideal for big regular meshes, 3 is worst).
+// ATVR: vertex shader runs per vertex (1 is ideal).
+struct VertexCacheStats
+{
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform cache over the index buffer
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+    unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    if (indices.size() < 3)
+        return stats;
+
+    // Timestamps instead of a real queue: a vertex is cached if it went in fewer than
+    // cacheSize misses ago
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    size_t misses = 0, usedCount = 0;
+    for (unsigned int v : indices)
+    {
+        if (!used[v])
+        {
+            used[v] = true;
+            usedCount++;
+        }
+        if (insertedAt[v] == 0 || misses - insertedAt[v] >= cacheSize)
+        {
+            misses++;
+            insertedAt[v] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (float)(indices.size() / 3);
+    stats.atvr = usedCount > 0 ? (float)misses / (float)usedCount : 0.0f;
+    return stats;
+}
+
+// Tipsify: fans around vertices in cache-friendly order. Returns the reordered triangle list;
+// if hardBoundaries is given it receives the first triangle of every run that started at a
+// dead end, where triangles can be reordered without hurting the cache much.
+inline std::vector<unsigned int> tipsify(const std::vector<unsigned int>& indices, size_t vertexCount,
+    unsigned int cacheSize = VERTEX_CACHE_SIZE, std::vector<size_t>* hardBoundaries = nullptr)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    // Triangles around each vertex, as offsets into one flat array
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int v : indices)
+        liveTriangles[v]++;
+    std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int corner = 0; corner < 3; corner++)
+            adjacency[fill[indices[t * 3 + corner]]++] = (unsigned int)t;
+
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+    long long fanning = indices.empty() ? -1 : (long long)indices[0];
+    bool afterDeadEnd = true;
+    while (fanning >= 0)
+    {
+        if (afterDeadEnd && hardBoundaries != nullptr)
+            hardBoundaries->push_back(output.size() / 3);
+
+        std::vector<unsigned int> candidates;
+        for (size_t a = adjacencyStart[(size_t)fanning]; a < adjacencyStart[(size_t)fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[t * 3 + corner];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Next fanning vertex: the candidate still in cache that will stay there longest
+        // while its remaining triangles are emitted
+        long long next = -1;
+        long long bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            long long priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = (long long)(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        afterDeadEnd = next < 0;
+        if (afterDeadEnd)
+        {
+            // Dead end: back up through recently used vertices, then scan in input order
+            while (!deadEnds.empty() && next < 0)
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = v;
+            }
+            while (next < 0 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = (long long)cursor;
+                cursor++;
+            }
+        }
+        fanning = next;
+    }
+    return output;
+}
+
+// Reorders triangles for the vertex cache (Tipsify), then reorders clusters of them so the
+// ones facing outwards from the mesh centre draw first and occlude the rest, cutting overdraw.
+// overdrawThreshold is how much worse than the Tipsify ACMR a cluster may be before it's
+// split off: 1.0 keeps Tipsify's order within runs, higher gives more, smaller clusters.
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+    unsigned int cacheSize = VERTEX_CACHE_SIZE, float overdrawThreshold = 1.05f)
+{
+    if (indices.size() < 3 || indices.size() % 3 != 0)
+        return;
+
+    std::vector<size_t> boundaries;
+    std::vector<unsigned int> ordered = tipsify(indices, positions.size(), cacheSize, &boundaries);
+    size_t triangleCount = ordered.size() / 3;
+    float targetAcmr = analyzeVertexCache(ordered, positions.size(), cacheSize).acmr * overdrawThreshold;
+
+    // Add soft boundaries wherever a cluster, starting with a cold cache, is already as good
+    // as the target, so splitting there costs little
+    std::vector<size_t> clusterStarts;
+    {
+        size_t nextHard = 0;
+        size_t clusterStart = 0, misses = 0;
+        std::vector<size_t> insertedAt(positions.size(), 0);
+        size_t clock = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            bool hard = nextHard < boundaries.size() && boundaries[nextHard] == t;
+            if (hard)
+                nextHard++;
+            if (t == 0 || hard || (t > clusterStart && (float)misses / (float)(t - clusterStart) <= targetAcmr))
+            {
+                clusterStarts.push_back(t);
+                clusterStart = t;
+                misses = 0;
+                clock += cacheSize; // Everything cached so far falls out
+            }
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = ordered[t * 3 + corner];
+                if (insertedAt[v] == 0 || clock - insertedAt[v] >= cacheSize)
+                {
+                    misses++;
+                    clock++;
+                    insertedAt[v] = clock;
+                }
+            }
+        }
+    }
+
+    // Sort clusters by how far out they sit along their own average normal
+    glm::vec3 meshCentre(0.0f);
+    float meshArea = 0.0f;
+    struct Cluster { size_t first, last; glm::vec3 centre, normal; float sortKey; };
+    std::vector<Cluster> clusters;
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        Cluster cluster;
+        cluster.first = clusterStarts[c];
+        cluster.last = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+        cluster.centre = glm::vec3(0.0f);
+        cluster.normal = glm::vec3(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster.first; t < cluster.last; t++)
+        {
+            const glm::vec3& a = positions[ordered[t * 3]];
+            const glm::vec3& b = positions[ordered[t * 3 + 1]];
+            const glm::vec3& d = positions[ordered[t * 3 + 2]];
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(n) * 0.5f;
+            cluster.normal = cluster.normal + n;
+            cluster.centre = cluster.centre + (a + b + d) * (triangleArea / 3.0f);
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+            cluster.centre = cluster.centre / area;
+        meshCentre = meshCentre + cluster.centre * area;
+        meshArea += area;
+        clusters.push_back(cluster);
+    }
+    if (meshArea > 0.0f)
+        meshCentre = meshCentre / meshArea;
+    for (Cluster& cluster : clusters)
+    {
+        float length = glm::length(cluster.normal);
+        cluster.sortKey = length > 0.0f ? glm::dot(cluster.centre - meshCentre, cluster.normal / length) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    indices.clear();
+    for (const Cluster& cluster : clusters)
+        indices.insert(indices.end(), ordered.begin() + cluster.first * 3, ordered.begin() + cluster.last * 3);
+}
+
+// Renumbers vertices in the order the index buffer first uses them, so vertex fetches walk
+// memory forwards. Rewrites indices and returns the old-to-new table (~0u for unused
+// vertices, which remapVertices drops).
+inline std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    unsigned int next = 0;
+    for (unsigned int& v : indices)
+    {
+        if (remap[v] == ~0u)
+            remap[v] = next++;
+        v = remap[v];
+    }
+    return remap;
+}
+
+template <typename T>
+void remapVertices(std::vector<T>& vertices, const std::vector<unsigned int>& remap)
+{
+    size_t count = 0;
+    for (unsigned int r : remap)
+        if (r != ~0u)
+            count++;
+    std::vector<T> reordered(count);
+    for (size_t v = 0; v < remap.size(); v++)
+        if (remap[v] != ~0u)
+            reordered[remap[v]] = vertices[v];
+    vertices.swap(reordered);
+}
+
+#endif
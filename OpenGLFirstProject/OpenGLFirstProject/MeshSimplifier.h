@@ -0,0 +1,309 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include "MeshOptimizer.h"
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// One level of detail: a range of a mesh's index buffer (relative to the mesh's first index)
+// drawing the same vertices with fewer triangles, and how far, in model units, its surface
+// may stray from the full-detail mesh.
+struct MeshLod
+{
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;
+};
+
+// Plane-distance quadric (Garland & Heckbert), area weighted. evaluate() returns the weighted
+// mean squared distance from p to the accumulated planes.
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0, weight = 0;
+
+    static Quadric FromPlane(double a, double b, double c, double d, double w)
+    {
+        Quadric q;
+        q.a2 = a * a * w; q.ab = a * b * w; q.ac = a * c * w; q.ad = a * d * w;
+        q.b2 = b * b * w; q.bc = b * c * w; q.bd = b * d * w;
+        q.c2 = c * c * w; q.cd = c * d * w;
+        q.d2 = d * d * w;
+        q.weight = w;
+        return q;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+    }
+
+    double Evaluate(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z
+                 + d2;
+        return weight > 0 ? std::fabs(e) / weight : 0.0;
+    }
+};
+
+// Simplifies an indexed triangle list towards targetIndexCount by collapsing edges onto one of
+// their endpoints, cheapest quadric error first, never exceeding maxError (model units).
+// The result indexes the same vertices, so it can share the original vertex buffer. Vertices
+// on borders and attribute seams (several vertices at one position) stay put, which keeps
+// UV seams and open edges intact. achievedError receives the largest error introduced.
+inline std::vector<unsigned int> simplifyMesh(const std::vector<unsigned int>& source, const std::vector<glm::vec3>& positions,
+    size_t targetIndexCount, float maxError, float* achievedError = nullptr)
+{
+    std::vector<unsigned int> indices = source;
+    size_t vertexCount = positions.size();
+    double maxCost = (double)maxError * (double)maxError;
+    double worstCost = 0.0;
+
+    // Lock vertices that share a position with another vertex (seams)
+    std::vector<bool> locked(vertexCount, false);
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3& p) const
+            {
+                uint32_t hash = 2166136261u;
+                for (int i = 0; i < 3; i++)
+                {
+                    uint32_t bits;
+                    std::memcpy(&bits, &p[i], sizeof(float));
+                    hash ^= bits;
+                    hash *= 16777619u;
+                }
+                return hash;
+            }
+        };
+        struct PositionEqual
+        {
+            bool operator()(const glm::vec3& a, const glm::vec3& b) const
+            {
+                return a.x == b.x && a.y == b.y && a.z == b.z;
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> firstAt;
+        std::vector<bool> used(vertexCount, false);
+        for (unsigned int v : indices)
+            used[v] = true;
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            if (!used[v])
+                continue;
+            auto inserted = firstAt.insert(std::make_pair(positions[v], v));
+            if (!inserted.second)
+            {
+                locked[v] = true;
+                locked[inserted.first->second] = true;
+            }
+        }
+    }
+
+    // Lock border vertices: a directed edge whose reverse no triangle uses
+    {
+        std::unordered_set<uint64_t> edges;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (int e = 0; e < 3; e++)
+                edges.insert(((uint64_t)indices[i + e] << 32) | indices[i + (e + 1) % 3]);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                if (edges.find(((uint64_t)b << 32) | a) == edges.end())
+                    locked[a] = locked[b] = true;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        const glm::vec3& p0 = positions[indices[i]];
+        glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            continue;
+        n = n / length;
+        Quadric q = Quadric::FromPlane(n.x, n.y, n.z, -glm::dot(n, p0), length * 0.5f);
+        for (int corner = 0; corner < 3; corner++)
+            quadrics[indices[i + corner]].Add(q);
+    }
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+
+    while (indices.size() > targetIndexCount)
+    {
+        // Triangles around each vertex
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+        for (unsigned int v : indices)
+            adjacencyStart[v + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+        std::vector<Collapse> collapses;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                if (!locked[a])
+                    collapses.push_back(Collapse{ a, b, quadrics[a].Evaluate(positions[b]) });
+                if (!locked[b])
+                    collapses.push_back(Collapse{ b, a, quadrics[b].Evaluate(positions[a]) });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        // Apply as many non-overlapping collapses as possible in one pass
+        std::vector<unsigned int> remap(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::vector<bool> touched(vertexCount, false);
+        size_t triangles = indices.size() / 3;
+        size_t targetTriangles = targetIndexCount / 3;
+        size_t applied = 0;
+        for (const Collapse& c : collapses)
+        {
+            if (c.cost > maxCost || triangles <= targetTriangles)
+                break;
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            // Reject collapses that would flip a triangle
+            bool flips = false;
+            size_t removed = 0;
+            for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1] && !flips; a++)
+            {
+                const unsigned int* t = &indices[adjacency[a] * 3];
+                if (t[0] == c.to || t[1] == c.to || t[2] == c.to)
+                {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    p[corner] = positions[t[corner]];
+                    q[corner] = t[corner] == c.from ? positions[c.to] : p[corner];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            remap[c.from] = c.to;
+            quadrics[c.to].Add(quadrics[c.from]);
+            worstCost = std::max(worstCost, c.cost);
+            triangles -= removed;
+            applied++;
+
+            // Everything around the collapsed vertex has changed; leave it for the next pass
+            for (unsigned int a = adjacencyStart[c.from]; a < adjacencyStart[c.from + 1]; a++)
+                for (int corner = 0; corner < 3; corner++)
+                    touched[indices[adjacency[a] * 3 + corner]] = true;
+        }
+        if (applied == 0)
+            break;
+
+        // Rewrite the index buffer and drop triangles that collapsed to lines
+        size_t write = 0;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    if (achievedError != nullptr)
+        *achievedError = (float)std::sqrt(worstCost);
+    return indices;
+}
+
+// Builds LODs by simplifying each level from the one before it, to the given fractions of the
+// original triangle count. LOD indices are appended to indices, which must hold LOD 0 on entry.
+// Stops early once a level can't get meaningfully smaller within maxError.
+inline std::vector<MeshLod> generateLodChain(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+    const std::vector<float>& ratios, float maxError)
+{
+    std::vector<MeshLod> lods(1);
+    lods[0].indexCount = (unsigned int)indices.size();
+
+    std::vector<unsigned int> current = indices;
+    size_t triangles = indices.size() / 3;
+    for (float ratio : ratios)
+    {
+        size_t target = (size_t)(triangles * ratio) * 3;
+        if (target >= current.size())
+            continue;
+
+        float error = 0.0f;
+        std::vector<unsigned int> next = simplifyMesh(current, positions, target, maxError, &error);
+        if (next.size() * 10 >= current.size() * 9)
+            break;
+        optimizeVertexCache(next, positions);
+
+        MeshLod lod;
+        lod.indexOffset = (unsigned int)indices.size();
+        lod.indexCount = (unsigned int)next.size();
+        lod.error = std::max(error, lods.back().error);
+        lods.push_back(lod);
+        indices.insert(indices.end(), next.begin(), next.end());
+        current.swap(next);
+    }
+    return lods;
+}
+
+// Picks the coarsest level whose error, projected onto the screen, stays under pixelThreshold.
+// centre, radius and scale place the mesh's bounding sphere in world space; projection[1][1]
+// gives the vertical field of view.
+inline unsigned int selectLod(const std::vector<MeshLod>& lods, const glm::vec3& centre, float radius, float scale,
+    const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight, float pixelThreshold = 1.0f)
+{
+    float distance = glm::length(centre - cameraPosition) - radius;
+    if (distance <= 0.0f)
+        return 0;
+    float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f / distance;
+
+    unsigned int level = 0;
+    for (unsigned int i = 1; i < lods.size(); i++)
+    {
+        if (lods[i].error * scale * pixelsPerUnit > pixelThreshold)
+            break;
+        level = i;
+    }
+    return level;
+}
+
+#endif
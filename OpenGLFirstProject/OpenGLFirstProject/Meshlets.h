@@ -0,0 +1,217 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "Parallel.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Cluster size limits; the usual mesh shader sizes, which also keep the clusters small
+// enough for culling to pay off
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// A run of consecutive triangles in a mesh's index buffer, with a bounding sphere and a
+// normal cone for culling. The cone is the meshoptimizer formulation: every triangle faces
+// away from a camera at p when dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius.
+struct Meshlet
+{
+    unsigned int indexOffset = 0; // In indices, relative to the mesh's first index
+    unsigned int indexCount = 0;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    float coneCutoff = 1.0f; // 1 means the triangles face too many ways to ever cull
+};
+
+// Range of indices to draw, in indices, relative to the mesh's first index
+struct IndexRange
+{
+    unsigned int first;
+    unsigned int count;
+};
+
+namespace meshlet_detail
+{
+    inline void computeBounds(Meshlet& meshlet, const std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions)
+    {
+        unsigned int first = meshlet.indexOffset, last = meshlet.indexOffset + meshlet.indexCount;
+
+        // Sphere around the box centre
+        glm::vec3 min = positions[indices[first]], max = min;
+        for (unsigned int i = first; i < last; i++)
+        {
+            min = glm::min(min, positions[indices[i]]);
+            max = glm::max(max, positions[indices[i]]);
+        }
+        meshlet.center = (min + max) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (unsigned int i = first; i < last; i++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(positions[indices[i]] - meshlet.center));
+
+        // Cone around the average of the unit triangle normals
+        std::vector<glm::vec3> normals;
+        glm::vec3 sum(0.0f);
+        for (unsigned int i = first; i + 2 < last; i += 3)
+        {
+            const glm::vec3& a = positions[indices[i]];
+            glm::vec3 n = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+            float length = glm::length(n);
+            if (length <= 0.0f)
+                continue;
+            normals.push_back(n / length);
+            sum = sum + normals.back();
+        }
+        float sumLength = glm::length(sum);
+        if (normals.empty() || sumLength <= 0.0f)
+            return;
+        meshlet.coneAxis = sum / sumLength;
+
+        float minDot = 1.0f;
+        for (const glm::vec3& n : normals)
+            minDot = std::min(minDot, glm::dot(n, meshlet.coneAxis));
+        // Below this the cone is nearly a half-space and would hardly ever cull
+        meshlet.coneCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+// Groups the first indexCount indices (a triangle list) into clusters of at most maxVertices
+// distinct vertices and maxTriangles triangles, and reorders those triangles so that every
+// cluster is one consecutive run. Clusters grow from the earliest unclaimed triangle through
+// its neighbours, nearest first, which keeps them compact and their normal cones narrow.
+// Indices past indexCount (other LODs) are left alone. Bounds are computed on all cores.
+inline std::vector<Meshlet> buildMeshlets(std::vector<unsigned int>& indices, const std::vector<glm::vec3>& positions,
+    size_t indexCount, unsigned int maxVertices = MESHLET_MAX_VERTICES, unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+{
+    size_t triangleCount = indexCount / 3;
+    size_t vertexCount = positions.size();
+
+    // Triangles around each vertex
+    std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyStart[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> ordered;
+    ordered.reserve(triangleCount * 3);
+    std::vector<bool> claimed(triangleCount, false);
+    std::vector<unsigned int> clusterOf(vertexCount, ~0u); // Cluster each vertex was last added to
+    std::vector<unsigned int> candidates;
+    size_t seed = 0;
+
+    while (true)
+    {
+        while (seed < triangleCount && claimed[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        unsigned int current = (unsigned int)meshlets.size();
+        Meshlet meshlet;
+        meshlet.indexOffset = (unsigned int)ordered.size();
+        unsigned int vertices = 0;
+        glm::vec3 centroid(0.0f);
+        candidates.assign(1, (unsigned int)seed);
+
+        while (meshlet.indexCount / 3 < maxTriangles)
+        {
+            // Best candidate: fewest new vertices, then closest to the cluster so far
+            long long best = -1;
+            unsigned int bestNew = 4;
+            float bestDistance = 0.0f;
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                unsigned int t = candidates[c];
+                if (claimed[t])
+                    continue;
+                unsigned int added = 0;
+                glm::vec3 center(0.0f);
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[t * 3 + corner];
+                    if (clusterOf[v] != current)
+                        added++;
+                    center = center + positions[v];
+                }
+                if (vertices + added > maxVertices)
+                    continue;
+                float distance = vertices > 0 ? glm::length(center / 3.0f - centroid) : 0.0f;
+                if (best < 0 || added < bestNew || (added == bestNew && distance < bestDistance))
+                {
+                    best = (long long)c;
+                    bestNew = added;
+                    bestDistance = distance;
+                }
+            }
+            if (best < 0)
+                break;
+
+            unsigned int t = candidates[(size_t)best];
+            claimed[t] = true;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int v = indices[t * 3 + corner];
+                ordered.push_back(v);
+                if (clusterOf[v] == current)
+                    continue;
+                clusterOf[v] = current;
+                vertices++;
+                centroid = centroid + (positions[v] - centroid) / (float)vertices;
+                for (size_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; a++)
+                    if (!claimed[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+            }
+            meshlet.indexCount += 3;
+
+            // Drop claimed candidates now and then so the scan stays short
+            if (candidates.size() > 4 * maxTriangles)
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                    [&](unsigned int c) { return claimed[c]; }), candidates.end());
+        }
+        meshlets.push_back(meshlet);
+    }
+    std::copy(ordered.begin(), ordered.end(), indices.begin());
+
+    parallelFor(meshlets.size(), [&](size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; i++)
+            meshlet_detail::computeBounds(meshlets[i], indices, positions);
+    }, 64);
+    return meshlets;
+}
+
+// Appends the index ranges of the meshlets that are inside the frustum and have at least one
+// triangle facing the camera, merging neighbours into one range. The frustum and the
+// camera position must be in the meshlets' (model) space. Returns the triangles kept.
+inline unsigned int cullMeshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum, const glm::vec3& cameraPosition,
+    std::vector<IndexRange>& ranges)
+{
+    unsigned int triangles = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius))
+            continue;
+        glm::vec3 toCenter = meshlet.center - cameraPosition;
+        if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+            continue;
+
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == meshlet.indexOffset)
+            ranges.back().count += meshlet.indexCount;
+        else
+            ranges.push_back(IndexRange{ meshlet.indexOffset, meshlet.indexCount });
+        triangles += meshlet.indexCount / 3;
+    }
+    return triangles;
+}
+
+#endif
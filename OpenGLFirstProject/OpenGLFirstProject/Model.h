@@ -10,38 +10,200 @@
 
 #include "Shader.h"
 #include "Mesh.h"
+#include "GLState.h"
+#include "IndexBuffer.h"
+#include "GeometryArena.h"
+#include "IndirectDrawList.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Camera.h"
+#include "Bounds.h"
+#include "Frustum.h"
 #include "stb_image.h"
 
 #include <string>
 #include <vector>
 using namespace std;
 
-class Model
+struct ModelLoadOptions
+{
+    // When false each mesh frees its vertices and indices once they're uploaded
+    bool keepCPUData = true;
+    // Split meshes with more than 65536 vertices so every part can use 16-bit indices
+    bool splitLargeMeshes = false;
+    // Pack every mesh into one vertex buffer and one index buffer behind a single VAO, and
+    // draw them all with one multi-draw call per material (see IndirectDrawList). The arena
+    // keeps no CPU copy, whatever keepCPUData says. Quantized positions then share one
+    // model-wide range, so every draw can use the same dequantization uniforms.
+    bool sharedBuffers = false;
+    // Reorder triangles for the vertex cache and overdraw, and vertices for fetch order
+    bool optimizeMeshes = true;
+    // Build simplified versions of every mesh, to these fractions of its triangle count, and
+    // let Draw() pick one per mesh from its projected error. The levels share the mesh's
+    // vertices and follow its full-detail indices in the same index buffer.
+    bool generateLods = false;
+    vector<float> lodRatios = { 0.5f, 0.25f, 0.1f };
+    // Largest error a level may introduce, as a fraction of the mesh's bounding radius
+    float lodMaxError = 0.01f;
+    // Split every mesh into clusters (see Meshlets.h) so the camera-aware Draw() can skip the
+    // ones outside the frustum or facing away
+    bool buildMeshlets = false;
+    // Keep a second, positions-only vertex buffer for DrawDepth()
+    bool depthStream = false;
+};
+
+// Loads a model into meshes using the vertex format given by Layout (see VertexLayout.h)
+template <typename Layout>
+class BasicModel
 {
 public:
-    vector<Mesh> meshes;
-    Model(string path)
+    vector<BasicMesh<Layout>> meshes;
+    GeometryArena<Layout> arena; // Holds all the meshes' data with ModelLoadOptions::sharedBuffers
+    IndirectDrawList<Layout> drawList;
+
+    // Extent of all the meshes in model space (see Bounds.h); each mesh has its own as well
+    BoundingBox bounds;
+    BoundingSphere boundingSphere;
+
+    BasicModel(string path, const ModelLoadOptions& options = ModelLoadOptions()) : options(options)
     {
         loadModel(path);
     }
 
     void Draw(Shader& shader)
     {
+        if (options.sharedBuffers)
+        {
+            // Undo whatever the camera-aware Draw() selected last: culled meshes and other levels
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                drawList.SelectRange(i, meshes[i].LodRange(0));
+            drawList.Draw(shader, meshes);
+            return;
+        }
         for (unsigned int i = 0; i < meshes.size(); i++)
         {
             meshes[i].Draw(shader);
         }
     }
 
+    // Draws each mesh at the coarsest level of detail whose error, projected with the camera
+    // and projection, stays under pixelThreshold pixels. Meshes drawn at full detail that
+    // have clusters only draw the visible ones, and meshes outside the frustum aren't drawn at
+    // all. model is the model matrix the shader was given.
+    void Draw(Shader& shader, const glm::mat4& model, const Camera& camera, const glm::mat4& projection,
+        float viewportHeight, float pixelThreshold = 1.0f)
+    {
+        // Uniform scales are the common case; otherwise the largest axis is a safe bound
+        float scale = std::max(glm::length(glm::vec3(model[0])),
+            std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+        // Culling happens in model space, so the bounds needn't be transformed
+        Frustum frustum(projection * camera.GetViewMatrix() * model);
+        glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(camera.Position, 1.0f));
+
+        submittedTriangles = 0;
+        if (!frustum.IntersectsSphere(boundingSphere))
+            return;
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            BasicMesh<Layout>& mesh = meshes[i];
+            MeshRange range;
+            if (!frustum.IntersectsBox(mesh.bounds))
+            {
+                range = mesh.LodRange(0);
+                range.indexCount = 0;
+                if (options.sharedBuffers)
+                    drawList.SelectRange(i, range);
+                continue;
+            }
+
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh.boundingSphere.Center, 1.0f));
+            unsigned int level = selectLod(mesh.lods, center, mesh.boundingSphere.Radius * scale, scale,
+                camera.Position, projection, viewportHeight, pixelThreshold);
+            range = mesh.LodRange(level);
+
+            if (level == 0 && !mesh.meshlets.empty())
+            {
+                // Drawn on its own, so leave it out of the multi-draw
+                if (options.sharedBuffers)
+                {
+                    range.indexCount = 0;
+                    drawList.SelectRange(i, range);
+                }
+                submittedTriangles += mesh.DrawVisibleClusters(shader, frustum, localCamera);
+                continue;
+            }
+
+            submittedTriangles += range.indexCount / 3;
+            if (options.sharedBuffers)
+                drawList.SelectRange(i, range);
+            else
+                mesh.Draw(shader, level);
+        }
+        if (options.sharedBuffers)
+            drawList.Draw(shader, meshes);
+    }
+
+    // Draws count instances of the whole model, one call per mesh; instances holds a model
+    // matrix for each (see InstanceBuffer.h)
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instances, count);
+    }
+
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances)
+    {
+        DrawInstanced(shader, instances, (unsigned int)instances.Count());
+    }
+
+    // Draws every mesh for a depth or shadow pass, from the position streams when the model
+    // was loaded with ModelLoadOptions::depthStream. The shader only needs aPos (and the
+    // dequantization uniforms with a quantized layout).
+    void DrawDepth(Shader& shader)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth(shader);
+    }
+
+    // Triangles the last camera-aware Draw() sent to the GPU
+    unsigned int SubmittedTriangles() const
+    {
+        return submittedTriangles;
+    }
+
 private:
     // Model data
     string directory;
     vector<Texture> textures_loaded;
+    ModelLoadOptions options;
+    size_t floatVertexBytes = 0;
+    size_t packedVertexBytes = 0;
+    size_t intIndexBytes = 0;
+    size_t packedIndexBytes = 0;
+    unsigned int submittedTriangles = 0;
+
+    // A mesh waiting for the arena to be uploaded
+    struct ArenaMesh
+    {
+        MeshRange range;
+        vector<Texture> textures;
+        PositionQuantization quantization;
+        vector<MeshLod> lods;
+        BoundingBox bounds;
+        BoundingSphere boundingSphere;
+        vector<Meshlet> meshlets;
+    };
+    vector<ArenaMesh> arenaMeshes;
+    PositionQuantization sharedQuantization;
 
     void loadModel(string path)
     {
         Assimp::Importer import;
-        const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        // Identical vertices have to be joined for the index buffer (and the vertex cache) to
+        // share anything between triangles
+        const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         {
@@ -50,7 +212,44 @@ private:
         }
         directory = path.substr(0, path.find_last_of('/'));
 
+        // Nodes can share meshes, so this is a lower bound, but it covers the usual case
+        meshes.reserve(scene->mNumMeshes);
+        if (options.sharedBuffers && Layout::PositionFormat::Quantized)
+        {
+            vector<aiMesh*> all(scene->mMeshes, scene->mMeshes + scene->mNumMeshes);
+            sharedQuantization = quantizationFor(all);
+        }
         processNode(scene->mRootNode, scene);
+
+        if (options.sharedBuffers)
+        {
+            arena.Upload(options.depthStream);
+            packedIndexBytes = arena.IndexBytes();
+            for (ArenaMesh& pending : arenaMeshes)
+            {
+                meshes.emplace_back(arena, pending.range, std::move(pending.textures), pending.quantization);
+                meshes.back().SetLods(std::move(pending.lods));
+                meshes.back().bounds = pending.bounds;
+                meshes.back().boundingSphere = pending.boundingSphere;
+                meshes.back().meshlets = std::move(pending.meshlets);
+            }
+            vector<ArenaMesh>().swap(arenaMeshes);
+
+            drawList.Build(arena, meshes);
+            cout << path << ": " << drawList.CommandCount() << " draws in " << drawList.BatchCount() << " multi-draw calls ("
+                 << (drawList.UsesIndirectDraws() ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex") << ")" << endl;
+        }
+
+        vector<BoundingSphere> spheres;
+        for (const BasicMesh<Layout>& mesh : meshes)
+        {
+            bounds.Expand(mesh.bounds);
+            spheres.push_back(mesh.boundingSphere);
+        }
+        boundingSphere = enclosingSphere(bounds, spheres);
+
+        cout << path << ": vertex data " << floatVertexBytes << " bytes as floats, " << packedVertexBytes << " bytes packed; "
+             << "index data " << intIndexBytes << " bytes as 32-bit, " << packedIndexBytes << " bytes packed" << endl;
     }
 
     void processNode(aiNode* node, const aiScene* scene)
@@ -59,7 +258,7 @@ private:
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene);
         }
 
         for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -68,25 +267,38 @@ private:
         }
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    // Appends the mesh to meshes, as several meshes if it gets split
+    void processMesh(aiMesh* mesh, const aiScene* scene)
     {
-        vector<Vertex> vertices;
+        vector<typename Layout::Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vector<glm::vec3> positions(mesh->mNumVertices); // Unquantized, for optimizing and simplifying
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
+
+        // Quantized positions are stored relative to the mesh's bounding box (or the whole
+        // model's, when the meshes share buffers)
+        PositionQuantization quantization;
+        if (options.sharedBuffers)
+            quantization = sharedQuantization;
+        else if (Layout::PositionFormat::Quantized)
+            quantization = quantizationFor(vector<aiMesh*>(1, mesh));
 
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            ::Vertex vertex;
             glm::vec3 vector;
 
             vector.x = mesh->mVertices[i].x;
             vector.y = mesh->mVertices[i].y;
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
+            positions[i] = vector;
 
             vector.x = mesh->mNormals[i].x;
             vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals->z;
+            vector.z = mesh->mNormals[i].z;
             vertex.Normal = vector;
 
             if (mesh->mTextureCoords[0]) // Does the mesh have texture coords?
@@ -101,9 +313,16 @@ private:
                 vertex.TexCoords = glm::vec2(0.0, 0.0);
             }
 
-            vertices.push_back(vertex);
+            vertices.push_back(Layout::Encode(vertex, quantization));
         }
 
+        size_t floatBytes = mesh->mNumVertices * sizeof(::Vertex);
+        size_t packedBytes = vertices.size() * sizeof(typename Layout::Vertex);
+        floatVertexBytes += floatBytes;
+        packedVertexBytes += packedBytes;
+        cout << "  mesh " << mesh->mName.C_Str() << ": " << mesh->mNumVertices << " vertices, "
+             << floatBytes << " -> " << packedBytes << " bytes" << endl;
+
         // Process indices
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -114,6 +333,18 @@ private:
             }
         }
 
+        // Only pure triangle lists can be reordered (Triangulate leaves points and lines alone)
+        if (options.optimizeMeshes && indices.size() == (size_t)mesh->mNumFaces * 3)
+        {
+            VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+            optimizeVertexCache(indices, positions);
+            vector<unsigned int> remap = optimizeVertexFetch(indices, vertices.size());
+            remapVertices(vertices, remap);
+            remapVertices(positions, remap);
+            VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+            cout << "    ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+        }
+
         if (mesh->mMaterialIndex >= 0)
         {
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
@@ -125,7 +356,93 @@ private:
             textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         }
 
-        return Mesh(vertices, indices, textures);
+        intIndexBytes += indices.size() * sizeof(unsigned int);
+        if (options.splitLargeMeshes && vertices.size() > MAX_SHORT_INDEX_VERTICES)
+        {
+            // Split vertex numbers rather than vertices, so each chunk gets its positions too
+            vector<unsigned int> ids(vertices.size());
+            for (unsigned int i = 0; i < ids.size(); i++)
+                ids[i] = i;
+            vector<MeshChunk<unsigned int>> chunks = splitForShortIndices(ids, indices);
+            cout << "  split into " << chunks.size() << " meshes for 16-bit indices" << endl;
+            for (MeshChunk<unsigned int>& chunk : chunks)
+            {
+                vector<typename Layout::Vertex> chunkVertices(chunk.vertices.size());
+                vector<glm::vec3> chunkPositions(chunk.vertices.size());
+                for (size_t v = 0; v < chunk.vertices.size(); v++)
+                {
+                    chunkVertices[v] = vertices[chunk.vertices[v]];
+                    chunkPositions[v] = positions[chunk.vertices[v]];
+                }
+                addMesh(std::move(chunkVertices), std::move(chunk.indices), chunkPositions, textures, quantization);
+            }
+            return;
+        }
+        addMesh(std::move(vertices), std::move(indices), positions, std::move(textures), quantization);
+    }
+
+    static PositionQuantization quantizationFor(const vector<aiMesh*>& sources)
+    {
+        bool empty = true;
+        glm::vec3 min, max;
+        for (aiMesh* mesh : sources)
+        {
+            for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+            {
+                glm::vec3 p(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                min = empty ? p : glm::min(min, p);
+                max = empty ? p : glm::max(max, p);
+                empty = false;
+            }
+        }
+        return empty ? PositionQuantization() : PositionQuantization::FromBounds(min, max);
+    }
+
+    void addMesh(vector<typename Layout::Vertex> vertices, vector<unsigned int> indices, const vector<glm::vec3>& positions,
+        vector<Texture> textures, const PositionQuantization& quantization)
+    {
+        BoundingBox box = computeBoundingBox(positions);
+        BoundingSphere sphere = computeBoundingSphere(positions, box);
+
+        vector<MeshLod> lods(1);
+        lods[0].indexCount = (unsigned int)indices.size();
+        if (options.generateLods && indices.size() % 3 == 0)
+        {
+            lods = generateLodChain(indices, positions, options.lodRatios, options.lodMaxError * sphere.Radius);
+            cout << "    LODs:";
+            for (const MeshLod& lod : lods)
+                cout << " " << lod.indexCount / 3;
+            cout << " triangles" << endl;
+        }
+
+        vector<Meshlet> meshlets;
+        if (options.buildMeshlets && indices.size() % 3 == 0)
+        {
+            meshlets = ::buildMeshlets(indices, positions, lods[0].indexCount);
+            cout << "    " << meshlets.size() << " clusters" << endl;
+        }
+
+        if (options.sharedBuffers)
+        {
+            ArenaMesh pending;
+            pending.range = arena.Add(vertices, indices);
+            pending.textures = std::move(textures);
+            pending.quantization = quantization;
+            pending.lods = std::move(lods);
+            pending.bounds = box;
+            pending.boundingSphere = sphere;
+            pending.meshlets = std::move(meshlets);
+            arenaMeshes.push_back(std::move(pending));
+            return;
+        }
+
+        packedIndexBytes += indices.size() * indexTypeSize(indexTypeFor(vertices.size()));
+        meshes.emplace_back(std::move(vertices), std::move(indices), std::move(textures), quantization, options.keepCPUData,
+            options.depthStream);
+        meshes.back().SetLods(std::move(lods));
+        meshes.back().bounds = box;
+        meshes.back().boundingSphere = sphere;
+        meshes.back().meshlets = std::move(meshlets);
     }
 
     vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
@@ -164,7 +481,7 @@ private:
     {
         unsigned int texture;
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        GLState::BindTexture(GL_TEXTURE_2D, texture);
 
         string filename = string(path);
         filename = directory + '/' + filename;
@@ -198,4 +515,7 @@ private:
     }
 };
 
+typedef BasicModel<FloatVertexLayout> Model;
+typedef BasicModel<CompactVertexLayout> CompactModel;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Calls body(first, last) on contiguous slices of [0, count), one slice per hardware thread,
+// and waits for them all. Small jobs run on the calling thread only.
+template <typename Body>
+void parallelFor(size_t count, Body body, size_t minPerThread = 256)
+{
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    threads = std::min(threads, std::max<size_t>(1, count / minPerThread));
+    if (threads <= 1)
+    {
+        body((size_t)0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    size_t slice = (count + threads - 1) / threads;
+    for (size_t first = slice; first < count; first += slice)
+        workers.emplace_back(body, first, std::min(first + slice, count));
+    body((size_t)0, std::min(slice, count));
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef POST_PROCESS_PIPELINE_H
+#define POST_PROCESS_PIPELINE_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+// A set of full-screen passes that all share one vertex stage.
+//
+// With ARB_separate_shader_objects (core in 4.1) the vertex stage is linked once as its own
+// separable program, each pass is a separable fragment-only program, and switching passes just
+// swaps the fragment stage of a single program pipeline object. Without it every pass is an
+// ordinary program, but they still attach the one vertex shader object from ShaderStageCache.
+class PostProcessPipeline
+{
+public:
+    PostProcessPipeline(const char* vertexPath) : vertexPath(vertexPath)
+    {
+        separable = glVersionAtLeast(4, 1) || hasGLExtension("GL_ARB_separate_shader_objects");
+        if (separable)
+        {
+            std::vector<std::string> includes;
+            vertexProgram = createSeparableProgram(GL_VERTEX_SHADER, vertexPath, includes);
+            glGenProgramPipelines(1, &pipeline);
+            glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT, vertexProgram);
+        }
+    }
+
+    // Adds a pass and returns its index; set the pass's uniforms through Pass(index) after Use(index)
+    unsigned int AddPass(const char* fragmentPath)
+    {
+        if (separable)
+        {
+            std::vector<std::string> includes;
+            passes.emplace_back(new Shader(createSeparableProgram(GL_FRAGMENT_SHADER, fragmentPath, includes)));
+            passes.back()->setSourcePaths(nullptr, fragmentPath, nullptr, true);
+            passes.back()->setIncludedFiles(includes);
+        }
+        else
+            passes.emplace_back(new Shader(vertexPath.c_str(), fragmentPath));
+        return (unsigned int)(passes.size() - 1);
+    }
+
+    Shader& Pass(unsigned int pass)
+    {
+        return *passes[pass];
+    }
+
+    // Make a pass current. Shader::set* calls then land on that pass's fragment program
+    // (via glActiveShaderProgram when running on a pipeline).
+    void Use(unsigned int pass)
+    {
+        if (separable)
+        {
+            // A bound program would take precedence over the pipeline
+            GLState::UseProgram(0);
+            GLState::BindProgramPipeline(pipeline);
+            glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, passes[pass]->ID);
+            glActiveShaderProgram(pipeline, passes[pass]->ID);
+        }
+        else
+        {
+            passes[pass]->use();
+        }
+    }
+
+    // Call before going back to ordinary programs
+    void Unbind()
+    {
+        if (separable)
+            GLState::BindProgramPipeline(0);
+    }
+
+    bool UsesSeparablePrograms() const
+    {
+        return separable;
+    }
+
+private:
+    std::string vertexPath;
+    bool separable = false;
+    GLuint pipeline = 0;
+    GLuint vertexProgram = 0;
+    std::vector<std::unique_ptr<Shader>> passes;
+
+    static GLuint createSeparableProgram(GLenum type, const char* path, std::vector<std::string>& includes)
+    {
+        std::string source = Shader::preprocess(path, ShaderDefines(), includes);
+        const char* code = source.c_str();
+        GLuint program = glCreateShaderProgramv(type, 1, &code);
+
+        int success;
+        char infoLog[512];
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "ERROR:SHADER:SEPARABLE_PROGRAM:LINKING_FAILED\n" << path << "\n" << infoLog << std::endl;
+        }
+        return program;
+    }
+};
+
+#endif
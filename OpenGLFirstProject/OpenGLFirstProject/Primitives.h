@@ -0,0 +1,373 @@
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLState.h"
+#include "GpuHeap.h"
+#include "HeapVertexArrays.h"
+#include "IndexBuffer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+
+// The built-in shapes. Everything 3D has radius (or half-extent) 1 and is centred on the origin.
+enum class Primitive
+{
+    Cube,
+    Quad,               // XY plane, facing +Z; covers NDC as is
+    FullscreenTriangle, // One triangle over all of NDC, so no pixels are shaded twice along a diagonal
+    UVSphere64,         // Segments around and from pole to pole
+    UVSphere32,
+    UVSphere16,
+    UVSphere8,
+    Icosphere1,         // Subdivisions of the icosahedron; even triangles, but the texture
+    Icosphere2,         // coords smear across the seam
+    Icosphere3,
+    Icosphere4,
+    Count
+};
+
+// Where a primitive lives in the shared buffers
+struct PrimitiveRange
+{
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    GLint baseVertex = 0;
+};
+
+namespace primitive_detail
+{
+    const float PI = 3.14159265359f;
+
+    const unsigned int UV_SPHERE_SEGMENTS[] = { 64, 32, 16, 8 };
+    const unsigned int ICOSPHERE_SUBDIVISIONS[] = { 1, 2, 3, 4 };
+
+    // Sizes of each generator's output, so every array is allocated once at its final size
+    inline size_t uvSphereVertexCount(unsigned int segments) { return (size_t)(segments + 1) * (segments + 1); }
+    inline size_t uvSphereIndexCount(unsigned int segments) { return (size_t)segments * segments * 6; }
+    inline size_t icosphereVertexCount(unsigned int subdivisions) { return 10 * ((size_t)1 << (2 * subdivisions)) + 2; }
+    inline size_t icosphereIndexCount(unsigned int subdivisions) { return 60 * ((size_t)1 << (2 * subdivisions)); }
+
+    struct Shape
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+
+        Shape(size_t vertexCount, size_t indexCount) : vertices(vertexCount), indices(indexCount) {}
+    };
+
+    inline Vertex vertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords)
+    {
+        Vertex v;
+        v.Position = position;
+        v.Normal = normal;
+        v.TexCoords = texCoords;
+        return v;
+    }
+
+    // Texture coords matching the UV sphere's parameterisation
+    inline glm::vec2 sphericalTexCoords(const glm::vec3& p)
+    {
+        float u = std::atan2(p.z, p.x) / (2.0f * PI);
+        return glm::vec2(u < 0.0f ? u + 1.0f : u, std::acos(std::max(-1.0f, std::min(1.0f, p.y))) / PI);
+    }
+
+    inline Shape cube()
+    {
+        // Normal and the two in-plane axes of each face, with u x v = normal so the quads wind
+        // counter-clockwise seen from outside
+        const glm::vec3 faces[6][3] = {
+            { glm::vec3( 1, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1,  0) },
+            { glm::vec3(-1, 0, 0), glm::vec3(0, 0,  1), glm::vec3(0, 1,  0) },
+            { glm::vec3( 0, 1, 0), glm::vec3(1, 0,  0), glm::vec3(0, 0, -1) },
+            { glm::vec3( 0,-1, 0), glm::vec3(1, 0,  0), glm::vec3(0, 0,  1) },
+            { glm::vec3( 0, 0, 1), glm::vec3(1, 0,  0), glm::vec3(0, 1,  0) },
+            { glm::vec3( 0, 0,-1), glm::vec3(-1, 0, 0), glm::vec3(0, 1,  0) },
+        };
+        const glm::vec2 corners[4] = { glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1), glm::vec2(0, 1) };
+        const unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+
+        Shape shape(24, 36);
+        for (unsigned int f = 0; f < 6; f++)
+        {
+            for (unsigned int c = 0; c < 4; c++)
+            {
+                glm::vec2 s = corners[c] * 2.0f - glm::vec2(1.0f);
+                shape.vertices[f * 4 + c] = vertex(faces[f][0] + faces[f][1] * s.x + faces[f][2] * s.y, faces[f][0], corners[c]);
+            }
+            for (unsigned int i = 0; i < 6; i++)
+                shape.indices[f * 6 + i] = f * 4 + quad[i];
+        }
+        return shape;
+    }
+
+    inline Shape quad()
+    {
+        Shape shape(4, 6);
+        const glm::vec2 corners[4] = { glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(1, 1), glm::vec2(0, 1) };
+        for (unsigned int c = 0; c < 4; c++)
+            shape.vertices[c] = vertex(glm::vec3(corners[c] * 2.0f - glm::vec2(1.0f), 0.0f), glm::vec3(0, 0, 1), corners[c]);
+        const unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+        std::copy(indices, indices + 6, shape.indices.begin());
+        return shape;
+    }
+
+    inline Shape fullscreenTriangle()
+    {
+        Shape shape(3, 3);
+        shape.vertices[0] = vertex(glm::vec3(-1, -1, 0), glm::vec3(0, 0, 1), glm::vec2(0, 0));
+        shape.vertices[1] = vertex(glm::vec3( 3, -1, 0), glm::vec3(0, 0, 1), glm::vec2(2, 0));
+        shape.vertices[2] = vertex(glm::vec3(-1,  3, 0), glm::vec3(0, 0, 1), glm::vec2(0, 2));
+        for (unsigned int i = 0; i < 3; i++)
+            shape.indices[i] = i;
+        return shape;
+    }
+
+    inline Shape uvSphere(unsigned int segments)
+    {
+        Shape shape(uvSphereVertexCount(segments), uvSphereIndexCount(segments));
+        size_t v = 0;
+        for (unsigned int x = 0; x <= segments; ++x)
+        {
+            for (unsigned int y = 0; y <= segments; ++y)
+            {
+                float xSegment = (float)x / (float)segments;
+                float ySegment = (float)y / (float)segments;
+                glm::vec3 p(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI),
+                    std::cos(ySegment * PI),
+                    std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI));
+                shape.vertices[v++] = vertex(p, p, glm::vec2(xSegment, ySegment));
+            }
+        }
+
+        // Two triangles per grid cell
+        size_t i = 0;
+        for (unsigned int y = 0; y < segments; ++y)
+        {
+            for (unsigned int x = 0; x < segments; ++x)
+            {
+                unsigned int a = y * (segments + 1) + x;
+                unsigned int b = a + 1;
+                unsigned int c = a + segments + 1;
+                unsigned int d = c + 1;
+                const unsigned int cell[6] = { a, c, b, b, c, d };
+                std::copy(cell, cell + 6, shape.indices.begin() + i);
+                i += 6;
+            }
+        }
+        return shape;
+    }
+
+    inline Shape icosphere(unsigned int subdivisions)
+    {
+        const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+        const glm::vec3 corners[12] = {
+            glm::vec3(-1, t, 0), glm::vec3(1, t, 0), glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+            glm::vec3(0, -1, t), glm::vec3(0, 1, t), glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+            glm::vec3(t, 0, -1), glm::vec3(t, 0, 1), glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1),
+        };
+        const unsigned int faces[60] = {
+            0, 11, 5,  0, 5, 1,   0, 1, 7,   0, 7, 10,  0, 10, 11,
+            1, 5, 9,   5, 11, 4,  11, 10, 2, 10, 7, 6,  7, 1, 8,
+            3, 9, 4,   3, 4, 2,   3, 2, 6,   3, 6, 8,   3, 8, 9,
+            4, 9, 5,   2, 4, 11,  6, 2, 10,  8, 6, 7,   9, 8, 1,
+        };
+
+        Shape shape(icosphereVertexCount(subdivisions), icosphereIndexCount(subdivisions));
+        std::vector<glm::vec3> positions(shape.vertices.size());
+        for (unsigned int c = 0; c < 12; c++)
+            positions[c] = glm::normalize(corners[c]);
+        std::copy(faces, faces + 60, shape.indices.begin());
+
+        // Split every triangle into four, sharing each edge's midpoint between its two triangles.
+        // Both index arrays are full size from the start; each pass reads the first quarter of
+        // what it writes.
+        std::vector<unsigned int> previous(shape.indices.size());
+        std::unordered_map<uint64_t, unsigned int> midpoints;
+        midpoints.reserve(shape.indices.size() / 2);
+        unsigned int vertexCount = 12;
+        size_t indexCount = 60;
+        for (unsigned int level = 0; level < subdivisions; level++)
+        {
+            std::copy(shape.indices.begin(), shape.indices.begin() + indexCount, previous.begin());
+            midpoints.clear();
+            auto midpoint = [&](unsigned int a, unsigned int b)
+            {
+                uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+                std::unordered_map<uint64_t, unsigned int>::iterator found = midpoints.find(key);
+                if (found != midpoints.end())
+                    return found->second;
+                positions[vertexCount] = glm::normalize(positions[a] + positions[b]);
+                midpoints[key] = vertexCount;
+                return vertexCount++;
+            };
+
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                unsigned int a = previous[i], b = previous[i + 1], c = previous[i + 2];
+                unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                const unsigned int split[12] = { a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca };
+                std::copy(split, split + 12, shape.indices.begin() + i * 4);
+            }
+            indexCount *= 4;
+        }
+
+        for (size_t v = 0; v < positions.size(); v++)
+            shape.vertices[v] = vertex(positions[v], positions[v], sphericalTexCoords(positions[v]));
+        return shape;
+    }
+
+    // Reorders a sphere for the vertex cache and for fetch locality
+    inline void optimize(Shape& shape)
+    {
+        std::vector<glm::vec3> positions(shape.vertices.size());
+        for (size_t v = 0; v < positions.size(); v++)
+            positions[v] = shape.vertices[v].Position;
+        optimizeVertexCache(shape.indices, positions);
+        remapVertices(shape.vertices, optimizeVertexFetch(shape.indices, shape.vertices.size()));
+    }
+
+    // Largest distance between a tessellated unit sphere and the true one, for LOD selection:
+    // the sagitta of the longest edge, which runs around the equator
+    inline float uvSphereError(unsigned int segments)
+    {
+        return 1.0f - std::cos(PI / (float)segments);
+    }
+}
+
+// Every built-in shape in one vertex and one index block of GpuHeap::Shared(), generated once
+// at startup. Drawing is a lookup in a fixed table and one draw call: nothing is created on
+// first use. Construct it once the context is current, and destroy it while it still is and
+// before GpuHeap::Shared().Release().
+//
+// Shapes are drawn through one of two VAOs over the same vertices. 3D shapes get position,
+// normal and texture coords at locations 0, 1 and 2 like meshes; Quad and FullscreenTriangle
+// get position and texture coords at 0 and 1, which is what the screen-space shaders read.
+class Primitives
+{
+public:
+    Primitives()
+    {
+        using namespace primitive_detail;
+
+        std::vector<Shape> shapes;
+        shapes.reserve((size_t)Primitive::Count);
+        shapes.push_back(cube());
+        shapes.push_back(quad());
+        shapes.push_back(fullscreenTriangle());
+        for (unsigned int segments : UV_SPHERE_SEGMENTS)
+            shapes.push_back(uvSphere(segments));
+        for (unsigned int subdivisions : ICOSPHERE_SUBDIVISIONS)
+            shapes.push_back(icosphere(subdivisions));
+        for (size_t s = (size_t)Primitive::UVSphere64; s < shapes.size(); s++)
+            optimize(shapes[s]);
+
+        // Lay the shapes end to end; indices stay relative to each shape's first vertex
+        size_t vertexCount = 0, indexCount = 0, largestShape = 0;
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            ranges[s].firstIndex = (unsigned int)indexCount;
+            ranges[s].indexCount = (unsigned int)shapes[s].indices.size();
+            ranges[s].baseVertex = (GLint)vertexCount;
+            vertexCount += shapes[s].vertices.size();
+            indexCount += shapes[s].indices.size();
+            largestShape = std::max(largestShape, shapes[s].vertices.size());
+        }
+        std::vector<Vertex> vertices(vertexCount);
+        std::vector<unsigned int> indices(indexCount);
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            std::copy(shapes[s].vertices.begin(), shapes[s].vertices.end(), vertices.begin() + ranges[s].baseVertex);
+            std::copy(shapes[s].indices.begin(), shapes[s].indices.end(), indices.begin() + ranges[s].firstIndex);
+        }
+
+        for (unsigned int i = 0; i < sizeof(UV_SPHERE_SEGMENTS) / sizeof(UV_SPHERE_SEGMENTS[0]); i++)
+        {
+            MeshLod lod;
+            lod.indexOffset = ranges[(size_t)Primitive::UVSphere64 + i].firstIndex;
+            lod.indexCount = ranges[(size_t)Primitive::UVSphere64 + i].indexCount;
+            lod.error = uvSphereError(UV_SPHERE_SEGMENTS[i]);
+            sphereLods.push_back(lod);
+        }
+
+        GpuHeap& heap = GpuHeap::Shared();
+        std::vector<unsigned char> indexBytes;
+        indexType = packIndices(indices, largestShape, indexBytes);
+        std::vector<GpuHeap::Handle> blocks;
+        blocks.push_back(heap.Allocate(indexBytes.data(), indexBytes.size()));
+        blocks.push_back(heap.Allocate(vertices.data(), vertices.size() * sizeof(Vertex)));
+
+        // Without its blocks the VAOs stay 0 and nothing is drawn
+        if (!arrays.Adopt("PRIMITIVES", blocks))
+            return;
+
+        VAO = arrays.AddArray(1, &FloatVertexLayout::SetupAttributes);
+        screenVAO = arrays.AddArray(1, &setupScreenAttributes);
+        GLState::BindVertexArray(0);
+
+        std::cout << "Primitives: " << vertexCount << " vertices, " << indexCount << " indices, "
+                  << vertices.size() * sizeof(Vertex) + indexBytes.size() << " bytes" << std::endl;
+    }
+
+    Primitives(const Primitives&) = delete;
+    Primitives& operator=(const Primitives&) = delete;
+
+    void Draw(Primitive primitive)
+    {
+        if (VAO == 0)
+            return;
+        const PrimitiveRange& r = ranges[(size_t)primitive];
+        arrays.Bind(primitive == Primitive::Quad || primitive == Primitive::FullscreenTriangle ? screenVAO : VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, r.indexCount, indexType,
+            (void*)(arrays.IndexOffset() + r.firstIndex * indexTypeSize(indexType)), r.baseVertex);
+    }
+
+    // Draws the UV sphere at the coarsest tessellation that looks the same from the camera.
+    // model must be the matrix the shader was given.
+    void DrawSphere(const glm::mat4& model, const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight)
+    {
+        float scale = glm::length(glm::vec3(model[0]));
+        glm::vec3 center = glm::vec3(model[3]);
+        unsigned int level = selectLod(sphereLods, center, scale, scale, cameraPosition, projection, viewportHeight);
+        Draw((Primitive)((unsigned int)Primitive::UVSphere64 + level));
+    }
+
+    const PrimitiveRange& Range(Primitive primitive) const
+    {
+        return ranges[(size_t)primitive];
+    }
+
+    // The UV sphere's tessellation levels, finest first, with their geometric error
+    const std::vector<MeshLod>& SphereLods() const
+    {
+        return sphereLods;
+    }
+
+private:
+    PrimitiveRange ranges[(size_t)Primitive::Count];
+    std::vector<MeshLod> sphereLods;
+    HeapVertexArrays arrays;
+    unsigned int VAO = 0, screenVAO = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+
+    // The screen-space shapes only need positions and texture coords
+    static void setupScreenAttributes(size_t base)
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, Position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(base + offsetof(Vertex, TexCoords)));
+    }
+};
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// 64-bit FNV-1a; pass the previous result back in as hash to keep accumulating
+inline uint64_t fnv1a64(const void* data, size_t length, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by the exact source text of every stage plus the GL vendor/renderer/version,
+// so an edited shader or a driver update simply misses and falls back to a normal compile.
+// The cache is off until SetDirectory is called.
+class ProgramBinaryCache
+{
+public:
+    struct Stats
+    {
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        unsigned int rejected = 0;  // Found on disk but refused by the driver
+        double savedMs = 0.0;       // Original compile/link time minus load time, summed over hits
+        double compileMs = 0.0;     // Time spent compiling/linking on misses
+    };
+
+    static void SetDirectory(const std::string& path)
+    {
+        state().directory = path;
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    static bool Enabled()
+    {
+        State& s = state();
+        if (s.directory.empty())
+            return false;
+        if (s.supported < 0)
+        {
+            // Program binaries are core in 4.1. On older contexts, querying the format count
+            // without the extension raises GL_INVALID_ENUM, and the entry points may not be loaded.
+            s.supported = 0;
+            bool available = glVersionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary");
+            if (available && glProgramBinary && glGetProgramBinary && glProgramParameteri)
+            {
+                GLint formats = 0;
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+                s.supported = formats > 0 ? 1 : 0;
+            }
+        }
+        return s.supported == 1;
+    }
+
+    static uint64_t Key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& geometryCode)
+    {
+        uint32_t version = FORMAT_VERSION;
+        uint64_t hash = fnv1a64(&version, sizeof(version));
+        const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for (GLenum name : driverStrings)
+        {
+            const char* str = (const char*)glGetString(name);
+            if (str)
+                hash = fnv1a64(str, std::char_traits<char>::length(str), hash);
+        }
+
+        // Hash each stage's length too so moving text between stages can't produce the same key
+        const std::string* stages[] = { &vertexCode, &fragmentCode, &geometryCode };
+        for (const std::string* stage : stages)
+        {
+            uint64_t length = stage->size();
+            hash = fnv1a64(&length, sizeof(length), hash);
+            hash = fnv1a64(stage->data(), stage->size(), hash);
+        }
+        return hash;
+    }
+
+    // Call before glLinkProgram so the driver keeps a retrievable binary around
+    static void PrepareForLink(GLuint program)
+    {
+        if (Enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // Returns true if the program was linked from the cache; otherwise the caller compiles as usual
+    static bool Load(GLuint program, uint64_t key)
+    {
+        if (!Enabled())
+            return false;
+
+        Stats& stats = state().stats;
+        auto start = std::chrono::steady_clock::now();
+
+        std::ifstream file(path(key), std::ios::binary);
+        Header header;
+        if (!file || !file.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.version != FORMAT_VERSION || header.key != key)
+        {
+            stats.misses++;
+            return false;
+        }
+
+        std::vector<char> binary(header.length);
+        if (!file.read(binary.data(), header.length))
+        {
+            stats.misses++;
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)header.length);
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            stats.rejected++;
+            stats.misses++;
+            return false;
+        }
+
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.hits++;
+        stats.savedMs += header.compileMs - loadMs;
+        return true;
+    }
+
+    // Writes a freshly linked program out; compileMs is what a later hit gets credited as saving
+    static void Store(GLuint program, uint64_t key, double compileMs)
+    {
+        if (!Enabled())
+            return;
+
+        state().stats.compileMs += compileMs;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header;
+        header.key = key;
+        header.compileMs = (float)compileMs;
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.length = (uint32_t)written;
+
+        std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cout << "ERROR:PROGRAM_BINARY_CACHE:WRITE_FAILED\n" << path(key) << std::endl;
+            return;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+    }
+
+    static const Stats& GetStats()
+    {
+        return state().stats;
+    }
+
+    static void LogStats()
+    {
+        if (!Enabled())
+            return;
+
+        const Stats& stats = state().stats;
+        unsigned int lookups = stats.hits + stats.misses;
+        std::cout << "Program binary cache: " << stats.hits << "/" << lookups << " hits ("
+                  << (lookups ? 100 * stats.hits / lookups : 0) << "%), "
+                  << stats.rejected << " rejected by driver, "
+                  << stats.savedMs << " ms saved, "
+                  << stats.compileMs << " ms compiling" << std::endl;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x4e425047; // "GPBN"
+    static const uint32_t FORMAT_VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic = MAGIC;
+        uint32_t version = FORMAT_VERSION;
+        uint64_t key = 0;
+        GLenum format = 0;
+        uint32_t length = 0;
+        float compileMs = 0.0f;
+    };
+
+    struct State
+    {
+        std::string directory;
+        int supported = -1;
+        Stats stats;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    static std::string path(uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return state().directory + "/" + name;
+    }
+};
+
+#endif
@@ -3,10 +3,66 @@
 
 #include <glad/glad.h> // Include glad to get all the required OpenGL headers
 
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "FrameData.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderStageCache.h"
+#include "GLExtensions.h"
+#include "GLState.h"
+
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+
+// 32-bit FNV-1a, used to key the uniform location table
+constexpr uint32_t fnv1a(const char* str, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// A uniform name reduced to its hash, so hot paths never build or hash strings.
+// Make them from literals at compile time (constexpr UniformHandle MODEL("model")),
+// or from a built name once at setup (e.g. array elements).
+struct UniformHandle
+{
+    uint32_t hash;
+
+    constexpr UniformHandle() : hash(0) {}
+
+    template <size_t N>
+    constexpr UniformHandle(const char (&name)[N]) : hash(fnv1a(name, N - 1)) {}
+
+    explicit UniformHandle(const std::string& name) : hash(fnv1a(name.c_str(), name.size())) {}
+};
+
+// Uniform table hits/misses and glUniform* calls issued/skipped, accumulated across all
+// shaders until reset (once per frame)
+struct UniformStats
+{
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+    unsigned int uploadsIssued = 0;
+    unsigned int uploadsSkipped = 0;
+};
+
+// Compile-time specialization of a shader, e.g. { { "LIGHT_COUNT", "4" } }.
+// Each entry becomes "#define NAME VALUE" right after the #version line.
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
 
 class Shader
 {
@@ -15,66 +71,35 @@ public:
     unsigned int ID;
 
     // Constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines())
     {
-        // 1. Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-
-        // Ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-        try
-        {
-            // Open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            
-            // Read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
+        setSourcePaths(vertexPath, fragmentPath, geometryPath);
+        setDefines(defines);
 
-            // Close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-
-            // Convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+        // 1. Retrieve the vertex/fragment source code from filePath, resolving #includes and defines
+        std::string vertexCode = loadSource(vertexPath);
+        std::string fragmentCode = loadSource(fragmentPath);
+        std::string geometryCode;
+        if (geometryPath != nullptr)
+            geometryCode = loadSource(geometryPath);
 
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure e)
+        // 2. Reuse a program binary from an earlier run if these exact sources were built on this driver before
+        ID = glCreateProgram();
+        uint64_t cacheKey = ProgramBinaryCache::Key(vertexCode, fragmentCode, geometryCode);
+        if (ProgramBinaryCache::Load(ID, cacheKey))
         {
-            std::cout << "ERROR:SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+            finishProgram();
+            return;
         }
+        auto compileStart = std::chrono::steady_clock::now();
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        // 2. Compile shaders
+        // 3. Compile shaders (stages already compiled for another program are shared)
         unsigned int vertex, fragment;
         int success;
         char infoLog[512];
 
         // Vertex Shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
+        vertex = ShaderStageCache::Acquire(GL_VERTEX_SHADER, vertexCode);
         // Print compile errors if any
         glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
         if (!success)
@@ -84,9 +109,7 @@ public:
         }
 
         // Fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
+        fragment = ShaderStageCache::Acquire(GL_FRAGMENT_SHADER, fragmentCode);
         // Print compile errors if any
         glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
         if (!success) 
@@ -99,10 +122,7 @@ public:
         unsigned int geometry;
         if (geometryPath != nullptr)
         {
-            const char* gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
+            geometry = ShaderStageCache::Acquire(GL_GEOMETRY_SHADER, geometryCode);
             glGetShaderiv(geometry, GL_COMPILE_STATUS, &success);
             if (!success)
             {
@@ -112,11 +132,11 @@ public:
         }
 
         // Shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        ProgramBinaryCache::PrepareForLink(ID);
         glLinkProgram(ID);
         // Print linking errors if any
         glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -125,52 +145,696 @@ public:
             glGetProgramInfoLog(ID, 512, NULL, infoLog);
             std::cout << "ERROR:SHADER:PROGRAM:LINKING_FAILED\n" << infoLog << std::endl;
         }
+        else
+        {
+            double compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count();
+            ProgramBinaryCache::Store(ID, cacheKey, compileMs);
+        }
 
-        // Delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        // Detach the shaders as they're linked into our program now; the stage cache owns them
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
         if (geometryPath != nullptr)
-            glDeleteShader(geometry);
+            glDetachShader(ID, geometry);
+        stages[0] = vertex;
+        stages[1] = fragment;
+        stages[2] = geometryPath != nullptr ? geometry : 0;
+
+        finishProgram();
+    }
+
+    // Adopts a program that has already been linked elsewhere (see ShaderRegistry)
+    explicit Shader(unsigned int program) : ID(program)
+    {
+        finishProgram();
+    }
+
+    // Prints the compile log of every stage that failed; only worth asking once a link has failed
+    static void printStageErrors(const GLuint programStages[3], const std::string paths[3])
+    {
+        static const char* stageNames[3] = { "VERTEX", "FRAGMENT", "GEOMETRY" };
+        for (int stage = 0; stage < 3; stage++)
+        {
+            if (!programStages[stage])
+                continue;
+            GLint compiled;
+            glGetShaderiv(programStages[stage], GL_COMPILE_STATUS, &compiled);
+            if (!compiled)
+            {
+                char infoLog[512];
+                glGetShaderInfoLog(programStages[stage], 512, NULL, infoLog);
+                std::cout << "ERROR:SHADER:" << stageNames[stage] << ":COMPILATION_FAILED\n" << paths[stage] << "\n" << infoLog << std::endl;
+            }
+        }
+    }
+
+    // Reads a whole shader source file, reporting (rather than throwing) on failure
+    static std::string readSource(const char* path)
+    {
+        std::ifstream shaderFile;
+        // Ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
+        }
+        catch (std::ifstream::failure e)
+        {
+            std::cout << "ERROR:SHADER::FILE_NOT_SUCCESSFULLY_READ\n" << path << std::endl;
+        }
+        return std::string();
+    }
+
+    // Reads a shader and expands it for compiling: every #include "file" (relative to the file
+    // doing the including) is pasted in place, once per stage, and the defines are inserted
+    // after #version. Included files are appended to includes.
+    static std::string preprocess(const char* path, const ShaderDefines& defines, std::vector<std::string>& includes)
+    {
+        std::vector<std::string> stageIncludes;
+        std::string source = expandIncludes(path, stageIncludes, 0);
+        for (size_t i = 0; i < stageIncludes.size(); i++)
+        {
+            if (std::find(includes.begin(), includes.end(), stageIncludes[i]) == includes.end())
+                includes.push_back(stageIncludes[i]);
+        }
+
+        if (defines.empty())
+            return source;
+
+        // #version has to stay the first thing in the shader
+        std::string defineLines;
+        for (size_t i = 0; i < defines.size(); i++)
+            defineLines += "#define " + defines[i].first + " " + defines[i].second + "\n";
+        size_t version = source.find("#version");
+        size_t insertAt = 0;
+        if (version != std::string::npos)
+        {
+            insertAt = source.find('\n', version);
+            insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+        }
+        source.insert(insertAt, defineLines);
+        return source;
+    }
+
+    // Remembers which files the program came from so it can be rebuilt by reload().
+    // Pass nullptr for stages the program doesn't have.
+    void setSourcePaths(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, bool separableProgram = false)
+    {
+        stagePaths[0] = vertexPath ? vertexPath : "";
+        stagePaths[1] = fragmentPath ? fragmentPath : "";
+        stagePaths[2] = geometryPath ? geometryPath : "";
+        separable = separableProgram;
+    }
+
+    // The defines the program was specialized with, reapplied by reload()
+    void setDefines(const ShaderDefines& programDefines)
+    {
+        defines = programDefines;
+    }
+
+    // Files pulled in through #include, for programs preprocessed outside the constructor
+    void setIncludedFiles(const std::vector<std::string>& includes)
+    {
+        includedFiles = includes;
+    }
+
+    // Takes over the stage cache references the program was linked from (see ShaderRegistry)
+    void adoptStages(const GLuint programStages[3])
+    {
+        for (int stage = 0; stage < 3; stage++)
+            stages[stage] = programStages[stage];
+    }
+
+    // Every file the program is built from, includes too
+    std::vector<std::string> sourceFiles() const
+    {
+        std::vector<std::string> files;
+        for (int stage = 0; stage < 3; stage++)
+        {
+            if (!stagePaths[stage].empty())
+                files.push_back(stagePaths[stage]);
+        }
+        files.insert(files.end(), includedFiles.begin(), includedFiles.end());
+        return files;
+    }
+
+    // Starts rebuilding the program from the files on disk without waiting for the driver.
+    // The current program stays in use until pollReload() sees the new one link.
+    void beginReload()
+    {
+        if (sourceFiles().empty())
+            return;
+
+        // A newer edit supersedes a rebuild that hasn't finished yet
+        if (pendingProgram)
+            discardPendingProgram();
+
+        static const GLenum stageTypes[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+        includedFiles.clear();
+        pendingProgram = glCreateProgram();
+        if (separable)
+            glProgramParameteri(pendingProgram, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        for (int stage = 0; stage < 3; stage++)
+        {
+            if (stagePaths[stage].empty())
+                continue;
+            pendingStages[stage] = ShaderStageCache::Acquire(stageTypes[stage], loadSource(stagePaths[stage].c_str()));
+            glAttachShader(pendingProgram, pendingStages[stage]);
+        }
+        glLinkProgram(pendingProgram);
+    }
+
+    // Call between frames. Swaps the rebuilt program in once it has linked and returns true on
+    // that frame. If the edit doesn't compile, the errors are printed and the last good program
+    // stays in use. Uniforms set on the old program have to be set again after a swap.
+    bool pollReload()
+    {
+        if (!pendingProgram)
+            return false;
+
+        // Don't block the frame while the driver is still compiling on its own threads
+        if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(pendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+        }
+
+        GLint linked;
+        char infoLog[512];
+        glGetProgramiv(pendingProgram, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            printStageErrors(pendingStages, stagePaths);
+            glGetProgramInfoLog(pendingProgram, 512, NULL, infoLog);
+            std::cout << "ERROR:SHADER:PROGRAM:LINKING_FAILED\n" << infoLog << "\nKeeping the last working program" << std::endl;
+            discardPendingProgram();
+            return false;
+        }
+
+        // The old stages go back to the cache, deleting any no other program still uses
+        for (int stage = 0; stage < 3; stage++)
+        {
+            if (pendingStages[stage])
+                glDetachShader(pendingProgram, pendingStages[stage]);
+            ShaderStageCache::Release(stages[stage]);
+            stages[stage] = pendingStages[stage];
+            pendingStages[stage] = 0;
+        }
+
+        GLState::ForgetProgram(ID);
+        glDeleteProgram(ID);
+        ID = pendingProgram;
+        pendingProgram = 0;
+        finishProgram();
+        return true;
     }
 
     // Use/Activate the shader
     void use()
     {
-        glUseProgram(ID);
+        GLState::UseProgram(ID);
     }
 
-    // Utility uniform functions:
+    // Utility uniform functions. Every value is checked against a CPU-side copy of what this
+    // program was last sent, and the glUniform* call is skipped when it's bit-identical.
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        upload1i(findUniform(name), (int)value);
     }
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        upload1i(findUniform(name), value);
     }
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        upload1f(findUniform(name), value);
     }
     void setMat3(const std::string& name, glm::mat3 value) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        uploadMatrix3fv(findUniform(name), glm::value_ptr(value));
     }
     void setMat4(const std::string& name, glm::mat4 value) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        uploadMatrix4fv(findUniform(name), glm::value_ptr(value));
     }
     void setVec2(const std::string& name, glm::vec2 value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        upload2fv(findUniform(name), glm::value_ptr(value));
     }
     void setVec3(const std::string& name, glm::vec3 value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+        upload3fv(findUniform(name), glm::value_ptr(value));
     }
     void setVec3(const std::string& name, float xVal, float yVal, float zVal) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(glm::vec3(xVal, yVal, zVal)));
+        glm::vec3 value(xVal, yVal, zVal);
+        upload3fv(findUniform(name), glm::value_ptr(value));
+    }
+
+    // Handle based setters, for the per-frame paths
+    void set(UniformHandle uniform, int value) const
+    {
+        upload1i(findUniform(uniform), value);
+    }
+    void set(UniformHandle uniform, float value) const
+    {
+        upload1f(findUniform(uniform), value);
+    }
+    void set(UniformHandle uniform, const glm::vec2& value) const
+    {
+        upload2fv(findUniform(uniform), glm::value_ptr(value));
+    }
+    void set(UniformHandle uniform, const glm::vec3& value) const
+    {
+        upload3fv(findUniform(uniform), glm::value_ptr(value));
+    }
+    void set(UniformHandle uniform, const glm::mat3& value) const
+    {
+        uploadMatrix3fv(findUniform(uniform), glm::value_ptr(value));
+    }
+    void set(UniformHandle uniform, const glm::mat4& value) const
+    {
+        uploadMatrix4fv(findUniform(uniform), glm::value_ptr(value));
+    }
+
+    // Whole-array setters: count elements go up in one glUniform*v call, starting at name
+    // (either "lights" or "lights[k]"). Skipped when every element is unchanged.
+    void setFloatArray(const std::string& name, const float* values, GLsizei count) const
+    {
+        uploadArray(findUniform(name), values, sizeof(float), count, glUniform1fv);
+    }
+    void setVec3Array(const std::string& name, const glm::vec3* values, GLsizei count) const
+    {
+        uploadArray(findUniform(name), values, sizeof(glm::vec3), count, glUniform3fv);
+    }
+    void setMat4Array(const std::string& name, const glm::mat4* values, GLsizei count) const
+    {
+        const UniformSlot* slot = findUniform(name);
+        GLsizei uploaded = uploadArrayCount(slot, values, sizeof(glm::mat4), count);
+        if (uploaded)
+            glUniformMatrix4fv(slot->location, uploaded, GL_FALSE, glm::value_ptr(values[0]));
+    }
+    void setFloatArray(UniformHandle uniform, const float* values, GLsizei count) const
+    {
+        uploadArray(findUniform(uniform), values, sizeof(float), count, glUniform1fv);
+    }
+    void setVec3Array(UniformHandle uniform, const glm::vec3* values, GLsizei count) const
+    {
+        uploadArray(findUniform(uniform), values, sizeof(glm::vec3), count, glUniform3fv);
+    }
+    void setMat4Array(UniformHandle uniform, const glm::mat4* values, GLsizei count) const
+    {
+        const UniformSlot* slot = findUniform(uniform);
+        GLsizei uploaded = uploadArrayCount(slot, values, sizeof(glm::mat4), count);
+        if (uploaded)
+            glUniformMatrix4fv(slot->location, uploaded, GL_FALSE, glm::value_ptr(values[0]));
+    }
+
+    // Location from the table built at link time. Unknown names (inactive or misspelled
+    // uniforms) return -1.
+    GLint uniformLocation(const std::string& name) const
+    {
+        const UniformSlot* slot = findUniform(name);
+        return slot ? slot->location : -1;
+    }
+
+    GLint uniformLocation(UniformHandle uniform) const
+    {
+        const UniformSlot* slot = findUniform(uniform);
+        return slot ? slot->location : -1;
+    }
+
+    static UniformStats& frameStats()
+    {
+        static UniformStats stats;
+        return stats;
+    }
+
+    static void resetFrameStats()
+    {
+        frameStats() = UniformStats();
+    }
+
+private:
+    struct UniformSlot
+    {
+        bool used = false;
+        uint32_t hash = 0;
+        GLint location = -1;
+        std::string name;
+
+        // Where this uniform's last uploaded value lives in shadowValues, and its flag in shadowKnown
+        uint32_t valueOffset = 0;
+        uint32_t valueSize = 0;
+        uint32_t element = 0;
+
+        // Elements from this one to the end of its array (1 for plain uniforms)
+        uint32_t arrayRemaining = 1;
+    };
+
+    // Where the program came from, for reloading
+    std::string stagePaths[3];
+    bool separable = false;
+    ShaderDefines defines;
+    std::vector<std::string> includedFiles;
+
+    std::string loadSource(const char* path)
+    {
+        return preprocess(path, defines, includedFiles);
+    }
+
+    static std::string expandIncludes(const std::string& path, std::vector<std::string>& included, int depth)
+    {
+        std::string source = readSource(path.c_str());
+        size_t slash = path.find_last_of("/\\");
+        std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+        std::stringstream lines(source);
+        std::string line, expanded;
+        while (std::getline(lines, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                expanded += line;
+                expanded += '\n';
+                continue;
+            }
+
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if (close == std::string::npos || depth > 16)
+            {
+                std::cout << "ERROR:SHADER:BAD_INCLUDE\n" << path << "\n" << line << std::endl;
+                continue;
+            }
+
+            // Every file is pasted in at most once, like #pragma once
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            if (std::find(included.begin(), included.end(), includePath) != included.end())
+                continue;
+            included.push_back(includePath);
+            expanded += expandIncludes(includePath, included, depth + 1);
+        }
+        return expanded;
+    }
+
+    // Rebuild in flight, see beginReload()
+    GLuint pendingProgram = 0;
+    GLuint pendingStages[3] = { 0, 0, 0 };
+    // Stage cache references held by the current program (none when it came from the binary cache)
+    GLuint stages[3] = { 0, 0, 0 };
+
+    void discardPendingProgram()
+    {
+        for (int stage = 0; stage < 3; stage++)
+        {
+            if (pendingStages[stage])
+                glDetachShader(pendingProgram, pendingStages[stage]);
+            ShaderStageCache::Release(pendingStages[stage]);
+            pendingStages[stage] = 0;
+        }
+        glDeleteProgram(pendingProgram);
+        pendingProgram = 0;
+    }
+
+    // Setup shared by freshly linked and cache-loaded programs
+    void finishProgram()
+    {
+        // Programs that declare the shared blocks all read each from the same binding point
+        const char* const blocks[] = { FRAME_DATA_BLOCK, OBJECT_DATA_BLOCK, LIGHT_DATA_BLOCK };
+        const unsigned int bindings[] = { FRAME_DATA_BINDING, OBJECT_DATA_BINDING, LIGHT_DATA_BINDING };
+        for (int i = 0; i < 3; i++)
+        {
+            GLuint blockIndex = glGetUniformBlockIndex(ID, blocks[i]);
+            if (blockIndex != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, blockIndex, bindings[i]);
+        }
+
+        buildUniformTable();
+    }
+
+    // Open-addressing table (linear probing), kept at most half full
+    std::vector<UniformSlot> uniformSlots;
+    uint32_t uniformMask = 0;
+
+    // Last value sent to each uniform element; shadowKnown is 0 until the first upload, since
+    // the program may start from an initializer in the GLSL
+    mutable std::vector<unsigned char> shadowValues;
+    mutable std::vector<unsigned char> shadowKnown;
+
+    const UniformSlot* findUniform(const std::string& name) const
+    {
+        uint32_t hash = fnv1a(name.c_str(), name.size());
+        for (uint32_t i = hash & uniformMask; ; i = (i + 1) & uniformMask)
+        {
+            const UniformSlot& slot = uniformSlots[i];
+            if (!slot.used)
+                break;
+            if (slot.hash == hash && slot.name == name)
+            {
+                frameStats().hits++;
+                return &slot;
+            }
+        }
+        frameStats().misses++;
+        return nullptr;
+    }
+
+    // Same lookup by hash alone; collisions between a program's own uniforms are reported at link time
+    const UniformSlot* findUniform(UniformHandle uniform) const
+    {
+        for (uint32_t i = uniform.hash & uniformMask; ; i = (i + 1) & uniformMask)
+        {
+            const UniformSlot& slot = uniformSlots[i];
+            if (!slot.used)
+                break;
+            if (slot.hash == uniform.hash)
+            {
+                frameStats().hits++;
+                return &slot;
+            }
+        }
+        frameStats().misses++;
+        return nullptr;
+    }
+
+    // Records value as the uniform's current value and says whether the driver needs to hear
+    // about it. Uniforms the program doesn't have never upload.
+    bool needsUpload(const UniformSlot* slot, const void* value, size_t bytes) const
+    {
+        if (!slot)
+            return false;
+
+        if (bytes == slot->valueSize)
+        {
+            unsigned char* shadow = &shadowValues[slot->valueOffset];
+            if (shadowKnown[slot->element] && std::memcmp(shadow, value, bytes) == 0)
+            {
+                frameStats().uploadsSkipped++;
+                return false;
+            }
+            std::memcpy(shadow, value, bytes);
+            shadowKnown[slot->element] = 1;
+        }
+        else
+        {
+            // Set through a setter of a different type; don't trust the copy any more
+            shadowKnown[slot->element] = 0;
+        }
+        frameStats().uploadsIssued++;
+        return true;
+    }
+
+    // Array version of needsUpload. Returns how many elements to send: count clamped to the end
+    // of the array, or 0 when they're all unchanged.
+    GLsizei uploadArrayCount(const UniformSlot* slot, const void* values, size_t elementBytes, GLsizei count) const
+    {
+        if (!slot || count <= 0)
+            return 0;
+        if (count > (GLsizei)slot->arrayRemaining)
+            count = (GLsizei)slot->arrayRemaining;
+
+        size_t bytes = elementBytes * count;
+        if (elementBytes != slot->valueSize)
+        {
+            for (GLsizei i = 0; i < count; i++)
+                shadowKnown[slot->element + i] = 0;
+            frameStats().uploadsIssued++;
+            return count;
+        }
+
+        bool allKnown = true;
+        for (GLsizei i = 0; i < count && allKnown; i++)
+            allKnown = shadowKnown[slot->element + i] != 0;
+        unsigned char* shadow = &shadowValues[slot->valueOffset];
+        if (allKnown && std::memcmp(shadow, values, bytes) == 0)
+        {
+            frameStats().uploadsSkipped++;
+            return 0;
+        }
+
+        std::memcpy(shadow, values, bytes);
+        for (GLsizei i = 0; i < count; i++)
+            shadowKnown[slot->element + i] = 1;
+        frameStats().uploadsIssued++;
+        return count;
+    }
+
+    template <typename UploadFunction>
+    void uploadArray(const UniformSlot* slot, const void* values, size_t elementBytes, GLsizei count, UploadFunction upload) const
+    {
+        GLsizei uploaded = uploadArrayCount(slot, values, elementBytes, count);
+        if (uploaded)
+            upload(slot->location, uploaded, (const GLfloat*)values);
+    }
+
+    void upload1i(const UniformSlot* slot, int value) const
+    {
+        if (needsUpload(slot, &value, sizeof(value)))
+            glUniform1i(slot->location, value);
+    }
+    void upload1f(const UniformSlot* slot, float value) const
+    {
+        if (needsUpload(slot, &value, sizeof(value)))
+            glUniform1f(slot->location, value);
+    }
+    void upload2fv(const UniformSlot* slot, const float* value) const
+    {
+        if (needsUpload(slot, value, 2 * sizeof(float)))
+            glUniform2fv(slot->location, 1, value);
+    }
+    void upload3fv(const UniformSlot* slot, const float* value) const
+    {
+        if (needsUpload(slot, value, 3 * sizeof(float)))
+            glUniform3fv(slot->location, 1, value);
+    }
+    void uploadMatrix3fv(const UniformSlot* slot, const float* value) const
+    {
+        if (needsUpload(slot, value, 9 * sizeof(float)))
+            glUniformMatrix3fv(slot->location, 1, GL_FALSE, value);
+    }
+    void uploadMatrix4fv(const UniformSlot* slot, const float* value) const
+    {
+        if (needsUpload(slot, value, 16 * sizeof(float)))
+            glUniformMatrix4fv(slot->location, 1, GL_FALSE, value);
+    }
+
+    // Bytes in one element of a uniform of this type, as the set* functions pass it
+    static uint32_t uniformTypeSize(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+            return 8;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+            return 12;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2:
+            return 16;
+        case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+            return 24;
+        case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+            return 32;
+        case GL_FLOAT_MAT3:
+            return 36;
+        case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+            return 48;
+        case GL_FLOAT_MAT4:
+            return 64;
+        default:
+            return 4; // Scalars, bools and samplers
+        }
+    }
+
+    // Walk GL_ACTIVE_UNIFORMS once and record every location, including each array element
+    // ("lights[3]" as well as "lights" and "lights[0]"), so the setters never ask the driver.
+    void buildUniformTable()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<UniformSlot> entries;
+        uint32_t valueBytes = 0, elementCount = 0;
+        std::vector<char> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+
+            // Uniform block members have no location
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location == -1)
+                continue;
+
+            // Each element gets its own shadow value; "name" and "name[0]" share the first
+            UniformSlot entry;
+            entry.location = location;
+            entry.valueSize = uniformTypeSize(type);
+            entry.valueOffset = valueBytes;
+            entry.element = elementCount;
+            entry.arrayRemaining = (uint32_t)size;
+
+            size_t bracket = name.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == name.size())
+            {
+                std::string base = name.substr(0, bracket);
+                entry.name = base;
+                entries.push_back(entry);
+                entry.name = name;
+                entries.push_back(entry);
+                for (GLint element = 1; element < size; element++)
+                {
+                    entry.name = base + "[" + std::to_string(element) + "]";
+                    entry.location = glGetUniformLocation(ID, entry.name.c_str());
+                    entry.valueOffset += entry.valueSize;
+                    entry.element++;
+                    entry.arrayRemaining--;
+                    entries.push_back(entry);
+                }
+            }
+            else
+            {
+                entry.name = name;
+                entries.push_back(entry);
+            }
+
+            valueBytes = entry.valueOffset + entry.valueSize;
+            elementCount = entry.element + 1;
+        }
+
+        shadowValues.assign(valueBytes, 0);
+        shadowKnown.assign(elementCount, 0);
+
+        uint32_t capacity = 8;
+        while (capacity < entries.size() * 2)
+            capacity *= 2;
+        uniformSlots.assign(capacity, UniformSlot());
+        uniformMask = capacity - 1;
+
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            uint32_t hash = fnv1a(entries[i].name.c_str(), entries[i].name.size());
+            uint32_t slot = hash & uniformMask;
+            while (uniformSlots[slot].used)
+            {
+                if (uniformSlots[slot].hash == hash)
+                    std::cout << "ERROR:SHADER:UNIFORM_HASH_COLLISION\n" << uniformSlots[slot].name << " / " << entries[i].name << std::endl;
+                slot = (slot + 1) & uniformMask;
+            }
+            uniformSlots[slot] = entries[i];
+            uniformSlots[slot].used = true;
+            uniformSlots[slot].hash = hash;
+        }
     }
 };
 
@@ -0,0 +1,56 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include "Shader.h"
+#include "ProgramBinaryCache.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+
+// All the specializations of one set of shader files. Instead of a single generic program that
+// branches on uniforms, callers ask for the variant they need (LIGHT_COUNT=4, BLUR_AXIS=0, ...)
+// and get a program compiled for exactly that. Each variant is built the first time it's asked
+// for and cached after that.
+class ShaderPermutations
+{
+public:
+    ShaderPermutations(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : "")
+    {
+    }
+
+    Shader& Get(const ShaderDefines& defines)
+    {
+        // The same defines in a different order are the same variant
+        ShaderDefines sorted = defines;
+        std::sort(sorted.begin(), sorted.end());
+
+        uint64_t key = fnv1a64("", 0);
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            std::string define = sorted[i].first + "=" + sorted[i].second + ";";
+            key = fnv1a64(define.data(), define.size(), key);
+        }
+
+        std::unique_ptr<Shader>& variant = variants[key];
+        if (!variant)
+            variant.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), geometryPath.empty() ? nullptr : geometryPath.c_str(), sorted));
+        return *variant;
+    }
+
+    size_t VariantCount() const
+    {
+        return variants.size();
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;
+    std::unordered_map<uint64_t, std::unique_ptr<Shader>> variants;
+};
+
+#endif
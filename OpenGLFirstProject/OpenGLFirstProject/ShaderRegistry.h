@@ -0,0 +1,231 @@
+#ifndef SHADER_REGISTRY_H
+#define SHADER_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderStageCache.h"
+#include "GLExtensions.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <iostream>
+
+typedef unsigned int ShaderHandle;
+
+// Builds every program in one batch. All programs are described up front with Add(), then
+// CompileAll() issues every glCompileShader and glLinkProgram back to back without asking for
+// any status, so the driver is free to work on them together (on its own threads when
+// GL_KHR_parallel_shader_compile is available). Nothing waits on a program until it is first
+// fetched with Get(), or for all of them at once with FinishAll(); Poll() only checks.
+class ShaderRegistry
+{
+public:
+    ShaderHandle Add(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const ShaderDefines& defines = ShaderDefines())
+    {
+        Entry entry;
+        entry.paths[0] = vertexPath;
+        entry.paths[1] = fragmentPath;
+        entry.paths[2] = geometryPath ? geometryPath : "";
+        entry.defines = defines;
+        entries.push_back(std::move(entry));
+        return (ShaderHandle)(entries.size() - 1);
+    }
+
+    // Issue compiles and links for everything added since the last call
+    void CompileAll()
+    {
+        parallel = hasGLExtension("GL_KHR_parallel_shader_compile");
+        if (parallel)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+        // Programs found in the binary cache are done right away; the rest get their stages compiled
+        for (Entry& entry : entries)
+        {
+            if (entry.issued)
+                continue;
+            entry.issued = true;
+            entry.start = std::chrono::steady_clock::now();
+
+            std::string sources[STAGE_COUNT];
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                if (!entry.paths[stage].empty())
+                    sources[stage] = Shader::preprocess(entry.paths[stage].c_str(), entry.defines, entry.includes);
+            }
+
+            entry.program = glCreateProgram();
+            entry.cacheKey = ProgramBinaryCache::Key(sources[0], sources[1], sources[2]);
+            if (ProgramBinaryCache::Load(entry.program, entry.cacheKey))
+            {
+                entry.fromCache = true;
+                complete(entry, true);
+                continue;
+            }
+
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                if (entry.paths[stage].empty())
+                    continue;
+                entry.stages[stage] = ShaderStageCache::Acquire(stageType(stage), sources[stage]);
+            }
+        }
+
+        // Then every link, still without waiting on a single compile
+        for (Entry& entry : entries)
+        {
+            if (entry.finished || entry.linking)
+                continue;
+            for (int stage = 0; stage < STAGE_COUNT; stage++)
+            {
+                if (entry.stages[stage])
+                    glAttachShader(entry.program, entry.stages[stage]);
+            }
+            ProgramBinaryCache::PrepareForLink(entry.program);
+            glLinkProgram(entry.program);
+            entry.linking = true;
+        }
+
+        Poll();
+    }
+
+    // Notes which programs the driver has finished, without waiting for the rest, and returns
+    // true once none are left. With parallel compile the programs build on driver threads while
+    // the caller does other work (loading models, say); calling this now and then between that
+    // work keeps the timings honest. Without the extension it can't tell and returns false
+    // until Get() or FinishAll() has waited for each program.
+    bool Poll()
+    {
+        bool pending = false;
+        for (Entry& entry : entries)
+        {
+            if (entry.finished || !entry.linking || entry.doneTime != std::chrono::steady_clock::time_point())
+                continue;
+            GLint done = GL_FALSE;
+            if (parallel)
+                glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (done)
+                entry.doneTime = std::chrono::steady_clock::now();
+            else
+                pending = true;
+        }
+        return !pending;
+    }
+
+    // The program is linked and ready to use by the time this returns
+    Shader& Get(ShaderHandle handle)
+    {
+        Entry& entry = entries[handle];
+        if (!entry.issued)
+            CompileAll();
+        if (!entry.finished)
+            finishLink(entry);
+        return *entry.shader;
+    }
+
+    void FinishAll()
+    {
+        for (ShaderHandle i = 0; i < entries.size(); i++)
+            Get(i);
+    }
+
+    // Per-program wall time from issuing the first GL call to the program being ready
+    void LogTimings() const
+    {
+        for (const Entry& entry : entries)
+        {
+            if (!entry.finished)
+                continue;
+            std::cout << "Shader " << entry.paths[0] << " + " << entry.paths[1];
+            if (!entry.paths[2].empty())
+                std::cout << " + " << entry.paths[2];
+            std::cout << ": " << entry.elapsedMs << " ms" << (entry.fromCache ? " (binary cache)" : "")
+                      << (entry.linked ? "" : " FAILED") << std::endl;
+        }
+    }
+
+private:
+    static const int STAGE_COUNT = 3;
+
+    static GLenum stageType(int stage)
+    {
+        static const GLenum types[STAGE_COUNT] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+        return types[stage];
+    }
+
+    struct Entry
+    {
+        std::string paths[STAGE_COUNT];
+        ShaderDefines defines;
+        std::vector<std::string> includes;
+        GLuint stages[STAGE_COUNT] = { 0, 0, 0 };
+        GLuint program = 0;
+        uint64_t cacheKey = 0;
+
+        bool issued = false;
+        bool linking = false;
+        bool finished = false;
+        bool linked = false;
+        bool fromCache = false;
+
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point doneTime;
+        double elapsedMs = 0.0;
+
+        std::unique_ptr<Shader> shader;
+    };
+
+    std::vector<Entry> entries;
+    bool parallel = false; // GL_KHR_parallel_shader_compile, checked by CompileAll()
+
+    void finishLink(Entry& entry)
+    {
+        GLint linked;
+        char infoLog[512];
+        glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+        if (entry.doneTime == std::chrono::steady_clock::time_point())
+            entry.doneTime = std::chrono::steady_clock::now();
+
+        if (!linked)
+        {
+            // Only now is it worth asking which stage was at fault
+            Shader::printStageErrors(entry.stages, entry.paths);
+            glGetProgramInfoLog(entry.program, 512, NULL, infoLog);
+            std::cout << "ERROR:SHADER:PROGRAM:LINKING_FAILED\n" << infoLog << std::endl;
+        }
+
+        double compileMs = std::chrono::duration<double, std::milli>(entry.doneTime - entry.start).count();
+        if (linked)
+            ProgramBinaryCache::Store(entry.program, entry.cacheKey, compileMs);
+        complete(entry, linked != 0);
+
+        // Use the time the program was seen to complete, not when someone happened to ask for it
+        entry.elapsedMs = compileMs;
+    }
+
+    void complete(Entry& entry, bool linked)
+    {
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+        {
+            if (entry.stages[stage])
+                glDetachShader(entry.program, entry.stages[stage]);
+        }
+
+        entry.finished = true;
+        entry.linked = linked;
+        entry.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - entry.start).count();
+        entry.shader.reset(new Shader(entry.program));
+        // The Shader now holds the stage references and gives them back when it's rebuilt
+        entry.shader->adoptStages(entry.stages);
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            entry.stages[stage] = 0;
+        entry.shader->setSourcePaths(entry.paths[0].c_str(), entry.paths[1].c_str(), entry.paths[2].empty() ? nullptr : entry.paths[2].c_str());
+        entry.shader->setDefines(entry.defines);
+        entry.shader->setIncludedFiles(entry.includes);
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SHADER_STAGE_CACHE_H
+#define SHADER_STAGE_CACHE_H
+
+#include <glad/glad.h>
+
+#include "ProgramBinaryCache.h"
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// Compiled shader objects keyed by stage type and source text. Byte-identical stages (the
+// full-screen bloom.vert/hdr.vert/screenShader.vert for example) are compiled once and the same
+// shader object is attached to every program that uses them. Each Acquire() takes a reference
+// that the program's Shader gives back with Release() when it is rebuilt or its rebuild fails,
+// so the stages of edited sources don't pile up during hot reload. Programs should detach
+// rather than delete stages after linking.
+class ShaderStageCache
+{
+public:
+    // Returns the shader object for this exact source, issuing the compile only the first time.
+    // Compile status is left for the caller to query, so batched builds stay unblocked.
+    static GLuint Acquire(GLenum type, const std::string& source)
+    {
+        uint64_t key = fnv1a64(&type, sizeof(type));
+        key = fnv1a64(source.data(), source.size(), key);
+
+        State& s = state();
+        std::unordered_map<uint64_t, Entry>::iterator it = s.stages.find(key);
+        if (it != s.stages.end())
+        {
+            it->second.references++;
+            s.hits++;
+            return it->second.shader;
+        }
+
+        const char* code = source.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, NULL);
+        glCompileShader(shader);
+        Entry entry;
+        entry.shader = shader;
+        entry.references = 1;
+        s.stages[key] = entry;
+        s.keys[shader] = key;
+        s.misses++;
+        return shader;
+    }
+
+    // Drops one reference taken by Acquire(); the shader object is deleted with the last one
+    static void Release(GLuint shader)
+    {
+        State& s = state();
+        std::unordered_map<GLuint, uint64_t>::iterator key = s.keys.find(shader);
+        if (key == s.keys.end())
+            return;
+
+        std::unordered_map<uint64_t, Entry>::iterator it = s.stages.find(key->second);
+        if (--it->second.references > 0)
+            return;
+
+        glDeleteShader(shader);
+        s.stages.erase(it);
+        s.keys.erase(key);
+    }
+
+    // Deletes every cached stage; programs already linked against them are unaffected
+    static void Clear()
+    {
+        State& s = state();
+        for (std::unordered_map<uint64_t, Entry>::iterator it = s.stages.begin(); it != s.stages.end(); ++it)
+            glDeleteShader(it->second.shader);
+        s.stages.clear();
+        s.keys.clear();
+    }
+
+    // Compiles avoided / compiles issued
+    static unsigned int Hits() { return state().hits; }
+    static unsigned int Misses() { return state().misses; }
+
+private:
+    struct Entry
+    {
+        GLuint shader = 0;
+        unsigned int references = 0;
+    };
+
+    struct State
+    {
+        std::unordered_map<uint64_t, Entry> stages;
+        // Reverse lookup so Release() only needs the shader object
+        std::unordered_map<GLuint, uint64_t> keys;
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include "Shader.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+// Rebuilds shaders when their source files change on disk, so shaders can be tuned without
+// restarting (and reloading every model and texture).
+//
+// On Linux the directories holding the sources are watched with inotify (directories rather
+// than files, since most editors save by writing a new file and renaming it over the old one).
+// Elsewhere the files' modification times are polled a couple of times a second.
+//
+// Call Update() once per frame. Only the shaders that use a changed file are rebuilt; each keeps
+// drawing with its old program until the new one has linked, and keeps it for good if the edit
+// doesn't compile.
+class ShaderWatcher
+{
+public:
+    ShaderWatcher()
+    {
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+            std::cout << "ERROR:SHADER_WATCHER:INOTIFY_INIT_FAILED" << std::endl;
+#endif
+    }
+
+    ~ShaderWatcher()
+    {
+#ifdef __linux__
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+#endif
+    }
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // The shader must outlive the watcher (or at least every Update() call)
+    void Watch(Shader& shader)
+    {
+        shaders.push_back(&shader);
+        watchFiles(shader);
+    }
+
+    // Returns the shaders whose new program was swapped in this frame, so callers can set
+    // their one-off uniforms again
+    std::vector<Shader*> Update()
+    {
+        std::vector<std::string> changed = changedFiles();
+        for (size_t i = 0; i < shaders.size(); i++)
+        {
+            if (usesAny(*shaders[i], changed))
+            {
+                std::cout << "Reloading shader " << shaders[i]->ID << std::endl;
+                shaders[i]->beginReload();
+            }
+        }
+
+        std::vector<Shader*> swapped;
+        for (size_t i = 0; i < shaders.size(); i++)
+        {
+            if (shaders[i]->pollReload())
+            {
+                // The rebuilt program may depend on different files now
+                watchFiles(*shaders[i]);
+                swapped.push_back(shaders[i]);
+            }
+        }
+        return swapped;
+    }
+
+private:
+    std::vector<Shader*> shaders;
+
+    // "dir/name" split the same way for watched files and for inotify events
+    static std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    static std::string fileNameOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static bool usesAny(const Shader& shader, const std::vector<std::string>& changed)
+    {
+        if (changed.empty())
+            return false;
+        std::vector<std::string> files = shader.sourceFiles();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            for (size_t j = 0; j < changed.size(); j++)
+            {
+                if (directoryOf(files[i]) == directoryOf(changed[j]) && fileNameOf(files[i]) == fileNameOf(changed[j]))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+#ifdef __linux__
+    int inotifyFd = -1;
+    std::map<int, std::string> watchedDirectories; // watch descriptor -> directory
+
+    void watchFiles(const Shader& shader)
+    {
+        if (inotifyFd < 0)
+            return;
+        std::vector<std::string> files = shader.sourceFiles();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            // inotify hands back the same descriptor for a directory that's already watched
+            std::string directory = directoryOf(files[i]);
+            int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0)
+                std::cout << "ERROR:SHADER_WATCHER:CANNOT_WATCH\n" << directory << std::endl;
+            else
+                watchedDirectories[wd] = directory;
+        }
+    }
+
+    std::vector<std::string> changedFiles()
+    {
+        std::vector<std::string> changed;
+        if (inotifyFd < 0)
+            return changed;
+
+        alignas(inotify_event) char buffer[4096];
+        for (;;)
+        {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break; // EAGAIN: nothing more this frame
+
+            for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len)
+            {
+                const inotify_event* event = (const inotify_event*)ptr;
+                std::map<int, std::string>::iterator directory = watchedDirectories.find(event->wd);
+                if (event->len == 0 || directory == watchedDirectories.end())
+                    continue;
+
+                // Saving often produces several events for one file
+                std::string path = directory->second + "/" + event->name;
+                bool seen = false;
+                for (size_t i = 0; i < changed.size(); i++)
+                    seen = seen || changed[i] == path;
+                if (!seen)
+                    changed.push_back(path);
+            }
+        }
+        return changed;
+    }
+#else
+    std::map<std::string, time_t> modifiedTimes;
+    std::chrono::steady_clock::time_point lastPoll;
+
+    static time_t modifiedTime(const std::string& path)
+    {
+#ifdef _WIN32
+        struct _stat info;
+        if (_stat(path.c_str(), &info) != 0)
+            return 0;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return 0;
+#endif
+        return info.st_mtime;
+    }
+
+    void watchFiles(const Shader& shader)
+    {
+        std::vector<std::string> files = shader.sourceFiles();
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (modifiedTimes.find(files[i]) == modifiedTimes.end())
+                modifiedTimes[files[i]] = modifiedTime(files[i]);
+        }
+    }
+
+    std::vector<std::string> changedFiles()
+    {
+        std::vector<std::string> changed;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - lastPoll < std::chrono::milliseconds(500))
+            return changed;
+        lastPoll = now;
+
+        for (std::map<std::string, time_t>::iterator it = modifiedTimes.begin(); it != modifiedTimes.end(); ++it)
+        {
+            time_t modified = modifiedTime(it->first);
+            if (modified != 0 && modified != it->second)
+            {
+                it->second = modified;
+                changed.push_back(it->first);
+            }
+        }
+        return changed;
+    }
+#endif
+};
+
+#endif
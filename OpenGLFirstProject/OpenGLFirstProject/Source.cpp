@@ -6,17 +6,26 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "ShaderRegistry.h"
+#include "ShaderWatcher.h"
 #include "Camera.h"
+#include "FrameData.h"
+#include "LightTable.h"
+#include "StreamingBuffer.h"
+#include "InstanceBuffer.h"
+#include "GpuHeap.h"
+#include "GLState.h"
+#include "Primitives.h"
 #include "Model.h";
 
 #include <iostream>
 #include <map>
 #include <random>
+#include <fstream>
+#include <memory>
 
 void renderScene(const Shader& shader);
-void renderCube();
-void renderQuad();
-void renderSphere();
+void runScene(GLFWwindow* window, unsigned int width, unsigned int height);
 unsigned int loadTexture(const char* path);
 
 bool firstMouse = true;
@@ -26,10 +35,12 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
+float screenHeight = 0.0f; // For turning LOD errors into pixels
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    GLState::Viewport(0, 0, width, height);
+    screenHeight = (float)height;
 }
 
 void processInput(GLFWwindow* window)
@@ -78,8 +89,57 @@ float lerp(float a, float b, float f)
     return a + f * (b - a);
 }
 
+// Print the last frame's counters, called about once a second from the render loop
+void printFrameStats()
+{
+    const UniformStats& uniforms = Shader::frameStats();
+    std::cout << "Uniform lookups: " << uniforms.hits << " hits, " << uniforms.misses << " misses; uploads: "
+              << uniforms.uploadsIssued << " issued, " << uniforms.uploadsSkipped << " skipped" << std::endl;
+    const GLStateStats& state = GLState::FrameStats();
+    std::cout << "GL state calls: " << state.issued << " issued, " << state.elided << " elided" << std::endl;
+    const StreamingStats& streaming = StreamingBuffer::FrameStats();
+    std::cout << "Streamed: " << streaming.writes << " writes, " << streaming.bytesWritten << " bytes; "
+              << streaming.waits << " waits (" << streaming.waitMilliseconds << " ms)" << std::endl;
+}
+
+// Print how full and how fragmented the mesh heap is
+void printHeapStats()
+{
+    GpuHeapStats heap = GpuHeap::Shared().Stats();
+    std::cout << "GPU heap: " << heap.allocations << " blocks in " << heap.pages << " buffers, " << heap.used << " / "
+              << heap.capacity << " bytes (" << heap.Utilization() * 100.0f << "% used), fragmentation "
+              << heap.Fragmentation() << " (worst buffer)" << std::endl;
+}
+
 unsigned int planeVAO;
 
+// Model matrices for amount rocks scattered in a ring around the origin
+std::vector<glm::mat4> asteroidTransforms(unsigned int amount, float radius, float offset)
+{
+    std::vector<glm::mat4> transforms(amount);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> displacement(-offset, offset);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (unsigned int i = 0; i < amount; i++)
+    {
+        float angle = (float)i / (float)amount * 360.0f;
+        glm::vec3 position(
+            std::sin(glm::radians(angle)) * radius + displacement(random),
+            displacement(random) * 0.4f, // Keep the ring flatter than it is wide
+            std::cos(glm::radians(angle)) * radius + displacement(random));
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::scale(model, glm::vec3(0.05f + unit(random) * 0.2f));
+        model = glm::rotate(model, glm::radians(unit(random) * 360.0f), glm::vec3(0.4f, 0.6f, 0.8f));
+        transforms[i] = model;
+    }
+    return transforms;
+}
+
+// Uniforms set every frame, hashed at compile time
+constexpr UniformHandle METALLIC_UNIFORM("metallic");
+constexpr UniformHandle ROUGHNESS_UNIFORM("roughness");
+
 int main()
 {
     glfwInit();
@@ -103,8 +163,9 @@ int main()
     }
 
     const unsigned int SCR_WIDTH = 1200, SCR_HEIGHT = 900;
-    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-    glEnable(GL_DEPTH_TEST);
+    GLState::Viewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    screenHeight = (float)SCR_HEIGHT;
+    GLState::Enable(GL_DEPTH_TEST);
 
     // Capture mouse & set up mouse event callback
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -113,14 +174,19 @@ int main()
 
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::Enable(GL_DEPTH_TEST);
+
+    runScene(window, SCR_WIDTH, SCR_HEIGHT);
 
-    // Set up our shaders
-    Shader shader("pbr.vert", "pbr.frag");
-    shader.use();
-    shader.setVec3("albedo", 0.5f, 0.5, 0.0);
-    shader.setFloat("ao", 0.0);
+    GpuHeap::Shared().Release();
+    glfwTerminate();
+    return 0;
+}
 
+// Sets up the scene and runs the render loop until the window closes. Everything holding GL
+// objects is local to this function, so it is all destroyed while the context is current.
+void runScene(GLFWwindow* window, unsigned int width, unsigned int height)
+{
     // Lights
     glm::vec3 lightPositions[] = {
         glm::vec3(-10.0,  10.0, 10.0),
@@ -134,43 +200,119 @@ int main()
         glm::vec3(300, 300, 300),
         glm::vec3(0, 300, 300)
     };
+    LightTable lights;
+    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); i++)
+        lights.Add(lightPositions[i], lightColors[i]);
+
+    // Set up our shaders, reusing program binaries from earlier runs where the driver allows it
+    ProgramBinaryCache::SetDirectory("shadercache");
+    ShaderRegistry shaders;
+    ShaderDefines pbrDefines = { { "LIGHT_COUNT", std::to_string(lights.Count()) } };
+    ShaderHandle pbrShader = shaders.Add("pbr.vert", "pbr.frag", nullptr, pbrDefines);
+
+    // An asteroid field around a planet: every rock is one instance of a single draw call.
+    // The rock and planet meshes aren't checked in, so the field only shows up when they are there.
+    const unsigned int ASTEROID_COUNT = 100000;
+    const glm::mat4 ASTEROID_FIELD = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -10.0f, -70.0f));
+    bool drawAsteroids = std::ifstream("rock/rock.obj").good() && std::ifstream("planet/planet.obj").good();
+    InstanceBuffer rockInstances(InstanceFormat::Matrix3x4);
+    InstanceBuffer planetInstance(InstanceFormat::Matrix3x4);
+    ShaderHandle asteroidShader = 0;
+    if (drawAsteroids)
+    {
+        ShaderDefines asteroidDefines = rockInstances.Defines();
+        asteroidDefines.push_back(std::make_pair(std::string("INVERSE_NORMALS"), std::string("0")));
+        asteroidShader = shaders.Add("shader.vert", "asteroid.frag", nullptr, asteroidDefines);
+    }
+    shaders.CompileAll();
+
+    // Load models while the driver compiles
+    std::unique_ptr<Model> rock, planet;
+    if (drawAsteroids)
+    {
+        rock.reset(new Model("rock/rock.obj"));
+        planet.reset(new Model("planet/planet.obj"));
+
+        std::vector<glm::mat4> rocks = asteroidTransforms(ASTEROID_COUNT, 50.0f, 5.0f);
+        for (glm::mat4& transform : rocks)
+            transform = ASTEROID_FIELD * transform;
+        rockInstances.Update(rocks);
+        planetInstance.Update(std::vector<glm::mat4>(1, glm::scale(ASTEROID_FIELD, glm::vec3(4.0f))));
+        std::cout << "Asteroid field: " << ASTEROID_COUNT << " rocks, " << rockInstances.Stride() * ASTEROID_COUNT
+                  << " bytes of instance data" << std::endl;
+    }
+
+    shaders.Poll();
+    shaders.FinishAll();
+    shaders.LogTimings();
+    ProgramBinaryCache::LogStats();
+
+    Shader& shader = shaders.Get(pbrShader);
+    auto setMaterialUniforms = [&shader]()
+    {
+        shader.use();
+        shader.setVec3("albedo", 0.5f, 0.5, 0.0);
+        shader.setFloat("ao", 0.0);
+    };
+    setMaterialUniforms();
+
+    // Rebuild shaders when their files are edited
+    ShaderWatcher shaderWatcher;
+    shaderWatcher.Watch(shader);
 
     int numRows = 5;
     int numColumns = 5;
     float spacing = 2.5;
 
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    shader.setMat4("projection", projection);
+    // Uniform blocks rewritten every frame or every draw (frame data, transforms, lights) go
+    // through one ring; 64 KB per segment is plenty for this scene
+    StreamingBuffer uniformStream(GL_UNIFORM_BUFFER, 64 * 1024);
+
+    // Projection, view and camera position are shared by every program through this UBO
+    FrameUniformBuffer frameData(uniformStream);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
+
+    // Cube, quad, full-screen triangle and spheres, all generated up front in one buffer
+    Primitives primitives;
+
+    float lastStatsTime = 0.0f;
 
-    for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); i++)
-    {
-        shader.setVec3("lightPositions[" + std::to_string(i) + "]", lightPositions[i]);
-        shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-    }
-    
     // RENDER LOOP:
     while (!glfwWindowShouldClose(window))
     {
+        Shader::resetFrameStats();
+        GLState::ResetFrameStats();
+        StreamingBuffer::ResetFrameStats();
+
         // input
         processInput(window);
 
+        // A reloaded program starts out with default uniform values
+        if (!shaderWatcher.Update().empty())
+            setMaterialUniforms();
+
         // Render
         glClearColor(0.1, 0.1, 0.1, 1);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        frameData.Update(camera, projection);
+
         shader.use();
-        glm::mat4 view = camera.GetViewMatrix();
-        shader.setMat4("view", view);
-        shader.setVec3("camPos", camera.Position);
+
+        // Move the lights, then stream the whole table as one block
+        glm::vec3 lightOffset = glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
+        for (unsigned int i = 0; i < lights.Count(); i++)
+            lights.Positions[i] = lightPositions[i] + lightOffset;
+        lights.Stream(uniformStream);
 
         // Render spheres:
         glm::mat4 model = glm::mat4(1.0);
         for (int row = 0; row < numRows; row++)
         {
-            shader.setFloat("metallic", (float)row / (float)numRows);
+            shader.set(METALLIC_UNIFORM, (float)row / (float)numRows);
             for (int col = 0; col < numColumns; col++)
             {
-                shader.setFloat("roughness", glm::clamp((float)col / (float)numColumns, 0.05f, 1.0f));
+                shader.set(ROUGHNESS_UNIFORM, glm::clamp((float)col / (float)numColumns, 0.05f, 1.0f));
 
                 model = glm::mat4(1.0);
                 model = glm::translate(model, glm::vec3(
@@ -178,235 +320,42 @@ int main()
                     (row - (numRows / 2)) * spacing,
                     -10.0
                 ));
-                shader.setMat4("model", model);
-                shader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-                renderSphere();
+                uniformStream.WriteAndBind(OBJECT_DATA_BINDING, ObjectData::For(model));
+                primitives.DrawSphere(model, camera.Position, projection, screenHeight);
             }
         }
 
-        for (unsigned int i = 0; i < sizeof(lightPositions) / sizeof(lightPositions[0]); i++)
+        for (unsigned int i = 0; i < lights.Count(); i++)
         {
-            glm::vec3 newPos = lightPositions[i] + glm::vec3(sin(glfwGetTime() * 5.0) * 5.0, 0.0, 0.0);
-            shader.setVec3("lightPositions[" + std::to_string(i) + "]", newPos);
-            shader.setVec3("lightColors[" + std::to_string(i) + "]", lightColors[i]);
-
             model = glm::mat4(1.0);
-            model = glm::translate(model, newPos);
+            model = glm::translate(model, lights.Positions[i]);
             model = glm::scale(model, glm::vec3(0.5));
-            shader.setMat4("model", model);
-            shader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(model))));
-            renderSphere();
+            uniformStream.WriteAndBind(OBJECT_DATA_BINDING, ObjectData::For(model));
+            primitives.DrawSphere(model, camera.Position, projection, screenHeight);
         }
 
-        // check and call events and swap the buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    glfwTerminate();
-    return 0;
-}
-
-// renderCube() renders a 1x1 3D cube in NDC.
-// -------------------------------------------------
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
-void renderCube()
-{
-    // initialize (if necessary)
-    if (cubeVAO == 0)
-    {
-        float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-            // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-            // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-             1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-        };
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex attributes
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-    }
-    // render Cube
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-}
-
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-}
-
-// This is just shamefully copy-pasted from the demo: https://learnopengl.com/code_viewer_gh.php?code=src/6.pbr/1.1.lighting/lighting.cpp
-unsigned int sphereVAO = 0;
-unsigned int indexCount;
-void renderSphere()
-{
-    if (sphereVAO == 0)
-    {
-        glGenVertexArrays(1, &sphereVAO);
-
-        unsigned int vbo, ebo;
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uv;
-        std::vector<glm::vec3> normals;
-        std::vector<unsigned int> indices;
-
-        const unsigned int X_SEGMENTS = 64;
-        const unsigned int Y_SEGMENTS = 64;
-        const float PI = 3.14159265359f;
-        for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
+        if (drawAsteroids)
         {
-            for (unsigned int y = 0; y <= Y_SEGMENTS; ++y)
-            {
-                float xSegment = (float)x / (float)X_SEGMENTS;
-                float ySegment = (float)y / (float)Y_SEGMENTS;
-                float xPos = std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-                float yPos = std::cos(ySegment * PI);
-                float zPos = std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI);
-
-                positions.push_back(glm::vec3(xPos, yPos, zPos));
-                uv.push_back(glm::vec2(xSegment, ySegment));
-                normals.push_back(glm::vec3(xPos, yPos, zPos));
-            }
+            Shader& asteroids = shaders.Get(asteroidShader);
+            asteroids.use();
+            planet->DrawInstanced(asteroids, planetInstance);
+            rock->DrawInstanced(asteroids, rockInstances);
         }
 
-        bool oddRow = false;
-        for (unsigned int y = 0; y < Y_SEGMENTS; ++y)
+        if (lastFrame - lastStatsTime >= 1.0f)
         {
-            if (!oddRow) // even rows: y == 0, y == 2; and so on
-            {
-                for (unsigned int x = 0; x <= X_SEGMENTS; ++x)
-                {
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                }
-            }
-            else
-            {
-                for (int x = X_SEGMENTS; x >= 0; --x)
-                {
-                    indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-                    indices.push_back(y * (X_SEGMENTS + 1) + x);
-                }
-            }
-            oddRow = !oddRow;
+            printFrameStats();
+            printHeapStats();
+            lastStatsTime = lastFrame;
         }
-        indexCount = static_cast<unsigned int>(indices.size());
 
-        std::vector<float> data;
-        for (unsigned int i = 0; i < positions.size(); ++i)
-        {
-            data.push_back(positions[i].x);
-            data.push_back(positions[i].y);
-            data.push_back(positions[i].z);
-            if (normals.size() > 0)
-            {
-                data.push_back(normals[i].x);
-                data.push_back(normals[i].y);
-                data.push_back(normals[i].z);
-            }
-            if (uv.size() > 0)
-            {
-                data.push_back(uv[i].x);
-                data.push_back(uv[i].y);
-            }
-        }
-        glBindVertexArray(sphereVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-        unsigned int stride = (3 + 2 + 3) * sizeof(float);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    }
+        // Every draw reading this frame's blocks has been issued
+        uniformStream.EndFrame();
 
-    glBindVertexArray(sphereVAO);
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_INT, 0);
+        // check and call events and swap the buffers
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
 }
 
 unsigned int loadTexture(char const* path)
@@ -426,7 +375,7 @@ unsigned int loadTexture(char const* path)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::BindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -0,0 +1,290 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+
+// Counters for the current frame, across every StreamingBuffer. Any wait means the GPU was
+// still reading a segment the CPU wanted to reuse, i.e. the ring is too small.
+struct StreamingStats
+{
+    unsigned int writes = 0;
+    size_t bytesWritten = 0;
+    unsigned int waits = 0;
+    double waitMilliseconds = 0.0;
+};
+
+// One buffer for data rewritten every frame (uniform blocks, per-draw and instance data),
+// split into segments used round-robin. Writes go to the current segment; EndFrame() (or a
+// segment filling up) fences it and moves on, and a segment is only reused once its fence
+// has signalled, so writing never stalls on the GPU as long as the ring is big enough.
+//
+// With ARB_buffer_storage (GL 4.4) the buffer is mapped once, persistently and coherently,
+// and writes are plain memcpys. Otherwise each write maps just its range unsynchronized; the
+// range has not been handed to the GPU since the buffer was last orphaned, which happens
+// whenever the ring wraps, so no fences are needed on that path.
+//
+// Destruction unmaps the buffer and deletes it and its fences, so destroy it while the
+// context is still current.
+class StreamingBuffer
+{
+public:
+    unsigned int ID = 0;
+
+    // segmentSize should cover a frame's writes; three segments let the CPU run two frames
+    // ahead of the GPU
+    StreamingBuffer(GLenum target, size_t segmentSize, unsigned int segmentCount = 3)
+        : target(target), segmentSize(segmentSize), fences(segmentCount, (GLsync)0)
+    {
+        persistent = glVersionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage");
+
+        // Uniform block ranges must start at the implementation's offset alignment
+        if (target == GL_UNIFORM_BUFFER)
+        {
+            GLint uniformAlignment = 0;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+            minAlignment = std::max<size_t>(minAlignment, (size_t)uniformAlignment);
+        }
+
+        // GL_COPY_WRITE_BUFFER leaves the VAO's element buffer and the other real bindings alone
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, capacity(), NULL, flags);
+            mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, capacity(), flags);
+            if (mapped == nullptr)
+            {
+                // Immutable storage can't be orphaned, so the per-write path needs a new buffer
+                std::cout << "ERROR::STREAMING_BUFFER::PERSISTENT_MAP_FAILED, mapping each write instead" << std::endl;
+                persistent = false;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                glDeleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            }
+        }
+        if (!persistent)
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity(), NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    StreamingBuffer(StreamingBuffer&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    StreamingBuffer& operator=(StreamingBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            ID = other.ID;
+            target = other.target;
+            segmentSize = other.segmentSize;
+            minAlignment = other.minAlignment;
+            fences = std::move(other.fences);
+            segment = other.segment;
+            head = other.head;
+            persistent = other.persistent;
+            mapped = other.mapped;
+            other.ID = 0;
+            other.mapped = nullptr;
+        }
+        return *this;
+    }
+
+    ~StreamingBuffer()
+    {
+        release();
+    }
+
+    // Copies bytes into the ring and returns their offset in the buffer, to bind or draw from
+    // before the next EndFrame(). Returns -1 if bytes can never fit in a segment, or if the
+    // range couldn't be mapped.
+    GLintptr Write(const void* data, size_t bytes, size_t alignment = 16)
+    {
+        if (bytes > segmentSize)
+        {
+            std::cout << "ERROR::STREAMING_BUFFER::WRITE_LARGER_THAN_SEGMENT " << bytes << " > " << segmentSize << std::endl;
+            return -1;
+        }
+        alignment = std::max(alignment, minAlignment);
+        size_t offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + bytes > segmentSize)
+        {
+            nextSegment();
+            offset = 0;
+        }
+
+        GLintptr position = (GLintptr)(segment * segmentSize + offset);
+        if (persistent)
+        {
+            std::memcpy(mapped + position, data, bytes);
+        }
+        else
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            void* range = glMapBufferRange(GL_COPY_WRITE_BUFFER, position, bytes,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            if (range == nullptr)
+            {
+                std::cout << "ERROR::STREAMING_BUFFER::MAP_FAILED " << bytes << " bytes at " << position << std::endl;
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                return -1;
+            }
+            std::memcpy(range, data, bytes);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        head = offset + bytes;
+
+        StreamingStats& stats = statsStorage();
+        stats.writes++;
+        stats.bytesWritten += bytes;
+        return position;
+    }
+
+    template <typename T>
+    GLintptr Write(const T& value, size_t alignment = 16)
+    {
+        return Write(&value, sizeof(T), alignment);
+    }
+
+    // Writes value and binds it to an indexed binding point of the buffer's target, e.g. a
+    // uniform block's binding
+    template <typename T>
+    void WriteAndBind(GLuint index, const T& value)
+    {
+        GLintptr offset = Write(value);
+        if (offset >= 0)
+            glBindBufferRange(target, index, ID, offset, sizeof(T));
+    }
+
+    // Call once the frame's draws that read this buffer have been issued
+    void EndFrame()
+    {
+        nextSegment();
+    }
+
+    bool Persistent() const
+    {
+        return persistent;
+    }
+
+    static const StreamingStats& FrameStats()
+    {
+        return statsStorage();
+    }
+
+    static void ResetFrameStats()
+    {
+        statsStorage() = StreamingStats();
+    }
+
+private:
+    GLenum target = GL_ARRAY_BUFFER;
+    size_t segmentSize = 0;
+    size_t minAlignment = 4;
+    std::vector<GLsync> fences; // One per segment; 0 when the GPU is done with it
+    unsigned int segment = 0;
+    size_t head = 0;            // Write position within the current segment
+    bool persistent = false;
+    char* mapped = nullptr;
+
+    static StreamingStats& statsStorage()
+    {
+        static StreamingStats stats;
+        return stats;
+    }
+
+    size_t capacity() const
+    {
+        return segmentSize * fences.size();
+    }
+
+    void nextSegment()
+    {
+        if (head == 0)
+            return; // Nothing written, nothing for the GPU to finish
+
+        if (persistent)
+            fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment = (segment + 1) % (unsigned int)fences.size();
+        head = 0;
+
+        if (!persistent)
+        {
+            // Hand the old storage to the driver and start on fresh storage
+            if (segment == 0)
+            {
+                glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+                glBufferData(GL_COPY_WRITE_BUFFER, capacity(), NULL, GL_STREAM_DRAW);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            return;
+        }
+        waitForSegment(segment);
+    }
+
+    void waitForSegment(unsigned int index)
+    {
+        GLsync fence = fences[index];
+        if (fence == 0)
+            return;
+
+        // Usually signalled long ago; only time it when it isn't
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            do
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            while (result == GL_TIMEOUT_EXPIRED);
+
+            StreamingStats& stats = statsStorage();
+            stats.waits++;
+            stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        glDeleteSync(fence);
+        fences[index] = 0;
+    }
+
+    void release()
+    {
+        if (ID == 0)
+            return;
+        for (GLsync& fence : fences)
+        {
+            if (fence != 0)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (mapped != nullptr)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "Shader.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Full-precision vertex, as read from the model file
+struct Vertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+// Maps a mesh's bounding box onto [-1, 1] for snorm16 positions. The vertex shader undoes it
+// with position = stored * Scale + Offset.
+struct PositionQuantization
+{
+    glm::vec3 Offset = glm::vec3(0.0f);
+    glm::vec3 Scale = glm::vec3(1.0f);
+
+    static PositionQuantization FromBounds(const glm::vec3& min, const glm::vec3& max)
+    {
+        PositionQuantization q;
+        q.Offset = (min + max) * 0.5f;
+        q.Scale = (max - min) * 0.5f;
+        // Flat meshes would divide by zero on that axis
+        for (int i = 0; i < 3; i++)
+            if (q.Scale[i] <= 0.0f)
+                q.Scale[i] = 1.0f;
+        return q;
+    }
+};
+
+// Attribute encodings. Each names the type stored per vertex, how glVertexAttribPointer reads
+// it, how a float value is packed into it, and the define (if any) a vertex shader needs to
+// decode it.
+
+struct PositionFloat3
+{
+    typedef glm::vec3 Storage;
+    static const GLint Components = 3;
+    static const GLenum Type = GL_FLOAT;
+    static const GLboolean Normalized = GL_FALSE;
+    static const bool Quantized = false;
+    static const char* Define() { return nullptr; }
+
+    static Storage Encode(const glm::vec3& position, const PositionQuantization&)
+    {
+        return position;
+    }
+};
+
+struct PositionSnorm16
+{
+    struct Storage { int16_t x, y, z, w; }; // w pads to 8 bytes so the next attribute stays aligned
+    static const GLint Components = 3;
+    static const GLenum Type = GL_SHORT;
+    static const GLboolean Normalized = GL_TRUE;
+    static const bool Quantized = true;
+    static const char* Define() { return "POSITION_QUANTIZED"; }
+
+    static Storage Encode(const glm::vec3& position, const PositionQuantization& quantization)
+    {
+        glm::vec3 unit = (position - quantization.Offset) / quantization.Scale;
+        Storage s;
+        s.x = (int16_t)glm::packSnorm1x16(unit.x);
+        s.y = (int16_t)glm::packSnorm1x16(unit.y);
+        s.z = (int16_t)glm::packSnorm1x16(unit.z);
+        s.w = 0;
+        return s;
+    }
+};
+
+struct NormalFloat3
+{
+    typedef glm::vec3 Storage;
+    static const GLint Components = 3;
+    static const GLenum Type = GL_FLOAT;
+    static const GLboolean Normalized = GL_FALSE;
+    static const char* Define() { return nullptr; }
+
+    static Storage Encode(const glm::vec3& normal)
+    {
+        return normal;
+    }
+};
+
+// Unit vector folded onto an octahedron and flattened to two snorm16s
+struct NormalOctahedral16
+{
+    struct Storage { int16_t x, y; };
+    static const GLint Components = 2;
+    static const GLenum Type = GL_SHORT;
+    static const GLboolean Normalized = GL_TRUE;
+    static const char* Define() { return "NORMAL_OCTAHEDRAL"; }
+
+    static Storage Encode(const glm::vec3& normal)
+    {
+        float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+        float x = l1 > 0.0f ? normal.x / l1 : 0.0f;
+        float y = l1 > 0.0f ? normal.y / l1 : 0.0f;
+        if (normal.z < 0.0f)
+        {
+            float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        Storage s;
+        s.x = (int16_t)glm::packSnorm1x16(x);
+        s.y = (int16_t)glm::packSnorm1x16(y);
+        return s;
+    }
+};
+
+// 10 bits per component, read straight back as a vec3 by the shader
+struct Normal2_10_10_10
+{
+    typedef uint32_t Storage;
+    static const GLint Components = 4;
+    static const GLenum Type = GL_INT_2_10_10_10_REV;
+    static const GLboolean Normalized = GL_TRUE;
+    static const char* Define() { return nullptr; }
+
+    static Storage Encode(const glm::vec3& normal)
+    {
+        return glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+    }
+};
+
+struct TexCoordFloat2
+{
+    typedef glm::vec2 Storage;
+    static const GLint Components = 2;
+    static const GLenum Type = GL_FLOAT;
+    static const GLboolean Normalized = GL_FALSE;
+    static const char* Define() { return nullptr; }
+
+    static Storage Encode(const glm::vec2& texCoords)
+    {
+        return texCoords;
+    }
+};
+
+struct TexCoordHalf2
+{
+    struct Storage { uint16_t u, v; };
+    static const GLint Components = 2;
+    static const GLenum Type = GL_HALF_FLOAT;
+    static const GLboolean Normalized = GL_FALSE;
+    static const char* Define() { return nullptr; }
+
+    static Storage Encode(const glm::vec2& texCoords)
+    {
+        Storage s;
+        s.u = glm::packHalf1x16(texCoords.x);
+        s.v = glm::packHalf1x16(texCoords.y);
+        return s;
+    }
+};
+
+// A vertex format put together from one encoding per attribute. Attributes keep the
+// locations the shaders already use: 0 position, 1 normal, 2 texture coords.
+template <typename PositionEncoding, typename NormalEncoding, typename TexCoordEncoding>
+struct VertexLayout
+{
+    typedef PositionEncoding PositionFormat;
+    typedef NormalEncoding NormalFormat;
+    typedef TexCoordEncoding TexCoordFormat;
+    typedef typename PositionEncoding::Storage Position; // One element of a position-only stream
+
+    struct Vertex
+    {
+        typename PositionEncoding::Storage Position;
+        typename NormalEncoding::Storage Normal;
+        typename TexCoordEncoding::Storage TexCoords;
+    };
+
+    static Vertex Encode(const ::Vertex& vertex, const PositionQuantization& quantization)
+    {
+        Vertex v;
+        v.Position = PositionEncoding::Encode(vertex.Position, quantization);
+        v.Normal = NormalEncoding::Encode(vertex.Normal);
+        v.TexCoords = TexCoordEncoding::Encode(vertex.TexCoords);
+        return v;
+    }
+
+    // Point attributes 0-2 at the vertices starting baseOffset bytes into the buffer bound to
+    // GL_ARRAY_BUFFER, for the bound VAO
+    static void SetupAttributes(size_t baseOffset = 0)
+    {
+        setupAttribute<PositionEncoding>(0, baseOffset + offsetof(Vertex, Position));
+        setupAttribute<NormalEncoding>(1, baseOffset + offsetof(Vertex, Normal));
+        setupAttribute<TexCoordEncoding>(2, baseOffset + offsetof(Vertex, TexCoords));
+    }
+
+    // Point attribute 0 at a tightly packed position stream (see ExtractPositions) starting
+    // baseOffset bytes into the buffer bound to GL_ARRAY_BUFFER, for the bound depth-only VAO
+    static void SetupPositionStream(size_t baseOffset = 0)
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, PositionEncoding::Components, PositionEncoding::Type, PositionEncoding::Normalized,
+            sizeof(Position), (void*)baseOffset);
+    }
+
+    // The positions of vertices, still encoded, for passes that read nothing else
+    static std::vector<Position> ExtractPositions(const std::vector<Vertex>& vertices)
+    {
+        std::vector<Position> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        return positions;
+    }
+
+    // Defines the vertex shader needs to decode this layout
+    static ShaderDefines Defines()
+    {
+        ShaderDefines defines;
+        const char* names[] = { PositionEncoding::Define(), NormalEncoding::Define(), TexCoordEncoding::Define() };
+        for (const char* name : names)
+            if (name != nullptr)
+                defines.push_back(std::make_pair(std::string(name), std::string("1")));
+        return defines;
+    }
+
+private:
+    template <typename Encoding>
+    static void setupAttribute(GLuint location, size_t offset)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, Encoding::Components, Encoding::Type, Encoding::Normalized, sizeof(Vertex), (void*)offset);
+    }
+};
+
+// The original 32-byte layout
+typedef VertexLayout<PositionFloat3, NormalFloat3, TexCoordFloat2> FloatVertexLayout;
+// 16 bytes: snorm16 positions, octahedral normals, half-float UVs
+typedef VertexLayout<PositionSnorm16, NormalOctahedral16, TexCoordHalf2> CompactVertexLayout;
+
+static_assert(sizeof(FloatVertexLayout::Vertex) == 32, "FloatVertexLayout should match the original Vertex");
+static_assert(sizeof(CompactVertexLayout::Vertex) == 16, "CompactVertexLayout should be half the size of Vertex");
+
+#endif
@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+uniform Material material;
+
+#include "frameData.glsl"
+
+// One fixed sun, so a hundred thousand rocks cost one texture fetch and a dot product each
+const vec3 sunDirection = normalize(vec3(-0.4, 0.6, 0.7));
+
+void main()
+{
+    vec3 color = texture(material.texture_diffuse1, fs_in.TexCoords).rgb;
+    float diffuse = max(dot(normalize(fs_in.Normal), sunDirection), 0.0);
+    FragColor = vec4(color * (0.15 + 0.85 * diffuse), 1.0);
+}
\ No newline at end of file
@@ -5,7 +5,17 @@ in vec2 TexCoords;
 
 uniform sampler2D image;
 
+// Define BLUR_AXIS as 0 (horizontal) or 1 (vertical) to build a single-direction pass;
+// without it the direction comes from the horizontal uniform
+#ifdef BLUR_AXIS
+#if BLUR_AXIS == 0
+const vec2 blurAxis = vec2(1.0, 0.0);
+#else
+const vec2 blurAxis = vec2(0.0, 1.0);
+#endif
+#else
 uniform bool horizontal;
+#endif
 uniform float weight[5] = float[] (0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
 
 void main()
@@ -13,21 +23,16 @@ void main()
     vec2 tex_offset = 1.0 / textureSize(image, 0);
     vec3 result = texture(image, TexCoords).rgb * weight[0];
 
-    if(horizontal)
-    {
-        for(int i = 1; i < 5; i++)
-        {
-            result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-        }
-    }
-    else
+#ifdef BLUR_AXIS
+    vec2 texelStep = tex_offset * blurAxis;
+#else
+    vec2 texelStep = horizontal ? vec2(tex_offset.x, 0.0) : vec2(0.0, tex_offset.y);
+#endif
+
+    for(int i = 1; i < 5; i++)
     {
-        for(int i = 1; i < 5; i++)
-        {
-            result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-            result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-        }
+        result += texture(image, TexCoords + texelStep * i).rgb * weight[i];
+        result += texture(image, TexCoords - texelStep * i).rgb * weight[i];
     }
 
     FragColor = vec4(result, 1.0);
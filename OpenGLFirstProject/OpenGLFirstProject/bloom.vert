@@ -1,9 +1,18 @@
 #version 330 core
+#extension GL_ARB_separate_shader_objects : enable
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+// Separable programs must redeclare the built-in outputs they write
+#ifdef GL_ARB_separate_shader_objects
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+#endif
+
 void main()
 {
     TexCoords = aTexCoords;
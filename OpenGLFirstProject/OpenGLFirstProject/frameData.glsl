@@ -0,0 +1,7 @@
+// Per-frame camera data, shared by every program. Must match FrameData in FrameData.h
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec3 camPos;
+};
@@ -0,0 +1,6 @@
+// Point lights, streamed every frame by LightTable::Stream. Needs LIGHT_COUNT defined first
+layout (std140) uniform LightData
+{
+    vec3 lightPositions[LIGHT_COUNT];
+    vec3 lightColors[LIGHT_COUNT];
+};
@@ -0,0 +1,6 @@
+// Per-draw transforms, streamed for every draw. Must match ObjectData in FrameData.h
+layout (std140) uniform ObjectData
+{
+    mat4 model;
+    mat3 normalMatrix;
+};
@@ -9,17 +9,16 @@ uniform float metallic;
 uniform float roughness;
 uniform float ao;
 
-uniform vec3 lightPositions[4];
-uniform vec3 lightColors[4];
+// Specialize with LIGHT_COUNT; 4 matches the lights in Source.cpp
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
 
-uniform vec3 camPos;
+#include "lightData.glsl"
 
-const float PI = 3.14159265359;
+#include "frameData.glsl"
 
-float DistributionGGX(vec3 N, vec3 H, float roughness);
-float GeometrySchlickGGX(float NdotV, float roughness);
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness);
-vec3 fresnelSchlick(float cosTheta, vec3 F0);
+#include "brdf.glsl"
 
 void main()
 {
@@ -30,7 +29,7 @@ void main()
     F0 = mix(F0, albedo, metallic);
 
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < 4; i++)
+    for(int i = 0; i < LIGHT_COUNT; i++)
     {
         // Calculate per-light radiance (on this fragment)
         vec3 L = normalize(lightPositions[i] - WorldPos);
@@ -63,44 +62,4 @@ void main()
     color = pow(color, vec3(1.0/2.2));
 
     FragColor = vec4(color, 1.0);
-}
-
-float DistributionGGX(vec3 N, vec3 H, float roughness)
-{
-    float a = roughness * roughness;
-    float a2 = a * a;
-    float NdotH = max(dot(N, H), 0.0);
-    float NdotH2 = NdotH * NdotH;
-
-    float nom = a2;
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * denom * denom;
-
-    return nom/denom;
-}
-
-float GeometrySchlickGGX(float NdotV, float roughness)
-{
-    float r = (roughness + 1.0);
-    float k = (r * r) / 8.0;
-
-    float nom = NdotV;
-    float denom = NdotV * (1.0 - k) + k;
-
-    return nom/denom;
-}
-
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
-{
-    float NdotV = max(dot(N, V), 0.0);
-    float NdotL = max(dot(N, L), 0.0);
-    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
-
-    return ggx1 * ggx2;
-}
-
-vec3 fresnelSchlick(float cosTheta, vec3 F0)
-{
-    return F0 + (1.0 - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }
\ No newline at end of file
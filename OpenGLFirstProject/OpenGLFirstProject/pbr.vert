@@ -1,22 +1,25 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef NORMAL_OCTAHEDRAL
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 out vec3 WorldPos;
 out vec3 Normal;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
-uniform mat3 normalMatrix;
+#include "frameData.glsl"
+#include "objectData.glsl"
+#include "vertexDecode.glsl"
 
 void main()
 {
     TexCoords = aTexCoords;
-    WorldPos = vec3(model * vec4(aPos, 1.0));
-    Normal = normalMatrix * aNormal;
+    WorldPos = vec3(model * vec4(decodePosition(aPos), 1.0));
+    Normal = normalMatrix * decodeNormal(aNormal);
 
     gl_Position = projection * view * vec4(WorldPos, 1.0);
 }
\ No newline at end of file
@@ -8,14 +8,15 @@ in VS_OUT {
     vec2 TexCoords;
 } fs_in;
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-};
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 16
+#endif
 
-uniform Light lights[16];
+// Separate arrays rather than an array of structs, so each is set with one call (see LightTable.h)
+uniform vec3 lightPositions[LIGHT_COUNT];
+uniform vec3 lightColors[LIGHT_COUNT];
 uniform sampler2D diffuseTexture;
-uniform vec3 viewPos;
+#include "frameData.glsl"
 
 void main()
 {           
@@ -25,15 +26,15 @@ void main()
     vec3 ambient = 0.0 * color;
     // lighting
     vec3 lighting = vec3(0.0);
-    for(int i = 0; i < 16; i++)
+    for(int i = 0; i < LIGHT_COUNT; i++)
     {
         // diffuse
-        vec3 lightDir = normalize(lights[i].Position - fs_in.FragPos);
+        vec3 lightDir = normalize(lightPositions[i] - fs_in.FragPos);
         float diff = max(dot(lightDir, normal), 0.0);
-        vec3 diffuse = lights[i].Color * diff * color;      
+        vec3 diffuse = lightColors[i] * diff * color;      
         vec3 result = diffuse;        
         // attenuation (use quadratic as we have gamma correction)
-        float distance = length(fs_in.FragPos - lights[i].Position);
+        float distance = length(fs_in.FragPos - lightPositions[i]);
         result *= 1.0 / (distance * distance);
         lighting += result;
                 
@@ -1,6 +1,10 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+#ifdef NORMAL_OCTAHEDRAL
+layout (location = 1) in vec2 aNormal;
+#else
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
 
 out VS_OUT {
@@ -9,21 +13,49 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "frameData.glsl"
+
+// Instanced draws (see InstanceBuffer.h) take the model matrix per instance, as a mat4 or as
+// its top three rows
+#if defined(INSTANCED) && defined(INSTANCE_MATRIX_3X4)
+layout (location = 3) in vec4 aInstanceRow0;
+layout (location = 4) in vec4 aInstanceRow1;
+layout (location = 5) in vec4 aInstanceRow2;
+#elif defined(INSTANCED)
+layout (location = 3) in mat4 aInstanceModel;
+#else
 uniform mat4 model;
+#endif
+
+#include "vertexDecode.glsl"
 
+// Define INVERSE_NORMALS as 0 or 1 to fix the choice at compile time instead of per vertex
+#ifndef INVERSE_NORMALS
 uniform bool inverse_normals;
+#endif
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
+#if defined(INSTANCED) && defined(INSTANCE_MATRIX_3X4)
+    mat4 model = transpose(mat4(aInstanceRow0, aInstanceRow1, aInstanceRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+#elif defined(INSTANCED)
+    mat4 model = aInstanceModel;
+#endif
+
+    vec3 position = decodePosition(aPos);
+    vec3 normal = decodeNormal(aNormal);
+
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));   
     vs_out.TexCoords = aTexCoords;
     
-    vec3 n = inverse_normals ? -aNormal : aNormal;
+#ifdef INVERSE_NORMALS
+    vec3 n = INVERSE_NORMALS != 0 ? -normal : normal;
+#else
+    vec3 n = inverse_normals ? -normal : normal;
+#endif
     
     mat3 normalMatrix = transpose(inverse(mat3(model)));
     vs_out.Normal = normalize(normalMatrix * n);
     
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(position, 1.0);
 }
\ No newline at end of file
@@ -12,11 +12,19 @@ uniform samplerCube shadowMap;
 uniform sampler2D normalMap;
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "frameData.glsl"
 
 uniform float far_plane;
 
-vec3 sampleOffsetDirections[20] = vec3[]
+// Number of PCF taps, up to the 20 offsets below
+#ifndef SHADOW_PCF_TAPS
+#define SHADOW_PCF_TAPS 20
+#endif
+#if SHADOW_PCF_TAPS > 20
+#error SHADOW_PCF_TAPS can be at most 20
+#endif
+
+const vec3 sampleOffsetDirections[20] = vec3[]
 (
    vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
    vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
@@ -34,8 +42,8 @@ float ShadowCalculation(vec3 fragPos)
 
     float shadow = 0.0;
     float bias = 0.15;
-    int samples = 20;
-    float viewDistance = length(viewPos - fragPos);
+    const int samples = SHADOW_PCF_TAPS;
+    float viewDistance = length(camPos - fragPos);
     float diskRadius = (1 + (viewDistance / far_plane)) / 25.0;
 
     for(int i = 0; i < samples; i++)
@@ -67,7 +75,7 @@ void main()
     vec3 diffuse = diff * lightColor;
 
     // Specular
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 viewDir = normalize(camPos - fs_in.FragPos);
     float spec = 0.0;
     vec3 halfwayDir = normalize(lightDir + viewDir);
     spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
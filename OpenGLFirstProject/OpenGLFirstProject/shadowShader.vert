@@ -11,19 +11,25 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "frameData.glsl"
 uniform mat4 model;
 
+// Define REVERSE_NORMALS as 0 or 1 to fix the choice at compile time instead of per vertex
+#ifndef REVERSE_NORMALS
 uniform bool reverse_normals;
+#endif
 
 void main()
 {
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+#ifdef REVERSE_NORMALS
+    vs_out.Normal = transpose(inverse(mat3(model))) * (REVERSE_NORMALS != 0 ? -1.0 * aNormal : aNormal);
+#else
     if(reverse_normals)
         vs_out.Normal = transpose(inverse(mat3(model))) * (-1.0 * aNormal);
     else
         vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+#endif
     vs_out.TexCoords = aTexCoords;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
\ No newline at end of file
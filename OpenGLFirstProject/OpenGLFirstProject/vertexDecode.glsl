@@ -0,0 +1,35 @@
+// Decoding for the compact vertex layouts in VertexLayout.h, shared by every vertex shader that
+// draws meshes, depth-only ones included. Shaders that read normals declare aNormal as a vec2
+// when NORMAL_OCTAHEDRAL is defined.
+
+// Quantized meshes store positions in [-1, 1] across their bounding box
+#ifdef POSITION_QUANTIZED
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodePosition(vec3 stored)
+{
+    return stored * positionScale + positionOffset;
+}
+#else
+vec3 decodePosition(vec3 stored)
+{
+    return stored;
+}
+#endif
+
+#ifdef NORMAL_OCTAHEDRAL
+vec3 decodeNormal(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -t : t;
+    v.y += v.y >= 0.0 ? -t : t;
+    return normalize(v);
+}
+#else
+vec3 decodeNormal(vec3 stored)
+{
+    return stored;
+}
+#endif